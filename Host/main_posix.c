@@ -0,0 +1,989 @@
+/* Includes ------------------------------------------------------------------*/
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "objshare_host.h"
+#include "peripheral.h"
+#include "packet_manager.h"
+#include "serial.h"
+#include "sys_time.h"
+#include "trace.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define DEFAULT_TRANSACTION_COUNT 1000
+#define CONNECT_TIMEOUT_IN_MS 2000U
+#define TRANSACTION_TIMEOUT_IN_MS 1000U
+#define BURST_QUEUE_DEPTH 16
+#define SETTLE_TIMEOUT_IN_MS 2000U
+#define DELTA_READ_COUNT 100
+#define VERSIONED_READ_COUNT 100
+// More writes than the peripheral journal keeps, OBJSHARE_PERIPHERAL_JOURNAL_LENGTH of them.
+#define JOURNAL_OVERFLOW_WRITE_COUNT 64
+
+/* Private function declarations ---------------------------------------------*/
+static pid_t spawnPeripheral(const char *path);
+static Bool_t waitFor(volatile Bool_t *flag, uint32_t timeout);
+static Bool_t readBurst(uint32_t count);
+static void dumpTrace(const char *path);
+static void addressSlotEventHandler(uint8_t slot);
+static void switchDirectionEventHandler(ObjshareProtocol_Direction_t direction);
+static void readResponseReceivedEventHandler(uint8_t slot, uint8_t objId);
+static void noResponseEventHandler(uint8_t slot);
+static void operationFailedEventHandler(uint8_t slot);
+static void pollResponseReceivedEventHandler(uint8_t slot);
+static void readMultiResponseReceivedEventHandler(uint8_t slot, ObjshareHost_ReadEntry_t *entries,
+												  uint8_t count);
+static void writeMultiResponseReceivedEventHandler(uint8_t slot, ObjshareHost_WriteEntry_t *entries,
+												   uint8_t count);
+static void notificationReceivedEventHandler(uint8_t slot, uint8_t objId, uint8_t *data,
+											 uint16_t dataLength);
+static void changesReceivedEventHandler(uint8_t slot, ObjshareHost_Changes_t *changes);
+
+/* Private variables ---------------------------------------------------------*/
+static volatile Bool_t PollResponse;
+static volatile Bool_t ReadResponse;
+static volatile uint32_t ReadResponseCount;
+static volatile Bool_t WriteResponse;
+static volatile Bool_t Failed;
+static volatile Bool_t NoResponse;
+static volatile uint32_t NotificationCount;
+static volatile Bool_t ChangesResponse;
+static float NotifiedValue;
+
+// Large object moved in fragments.
+static float CalibrationTable[PRP_CALIBRATION_TABLE_LENGTH];
+static float CalibrationTableReadBack[PRP_CALIBRATION_TABLE_LENGTH];
+
+// Write running past the end of the calibration table; refused before it changes the table.
+static uint8_t OversizedTable[sizeof(CalibrationTable) + 76];
+static ObjshareHost_Changes_t TableChanges;
+
+// Slot state refreshed in one read multi round trip.
+static char Name[PRP_MAX_NAME_LENGTH + 1];
+static Prp_Properties_t Properties;
+static float TargetValue;
+static float CurrentValue;
+static uint8_t State;
+static uint8_t ErrorCode;
+static float PidCoeffs[3];
+static uint8_t CommandPoint;
+static ObjshareHost_ReadEntry_t SlotEntries[] = {
+	{PRP_NAME_OBJ_ID, (uint8_t *)Name, PRP_MAX_NAME_LENGTH},
+	{PRP_PROPERTIES_OBJ_ID, (uint8_t *)&Properties, sizeof(Properties)},
+	{PRP_TARGET_VALUE_OBJ_ID, (uint8_t *)&TargetValue, sizeof(TargetValue)},
+	{PRP_CURRENT_VALUE_OBJ_ID, (uint8_t *)&CurrentValue, sizeof(CurrentValue)},
+	{PRP_STATE_OBJ_ID, &State, sizeof(State)},
+	{PRP_ERROR_CODE_OBJ_ID, &ErrorCode, sizeof(ErrorCode)},
+	{PRP_PID_I_COEFF_OBJ_ID, (uint8_t *)&PidCoeffs[0], sizeof(float)},
+	{PRP_PID_K_COEFF_OBJ_ID, (uint8_t *)&PidCoeffs[1], sizeof(float)},
+	{PRP_PID_D_COEFF_OBJ_ID, (uint8_t *)&PidCoeffs[2], sizeof(float)},
+	{PRP_COMMAND_POINT_OBJ_ID, &CommandPoint, sizeof(CommandPoint)}};
+
+// Controller reconfigured in one write multi round trip; the current value is read only.
+static float NewPidCoeffs[3] = {0.5f, 2.0f, 0.125f};
+static float NewTargetValue = 210.0f;
+static ObjshareHost_WriteEntry_t ControllerEntries[] = {
+	{PRP_PID_I_COEFF_OBJ_ID, (uint8_t *)&NewPidCoeffs[0], sizeof(float)},
+	{PRP_PID_K_COEFF_OBJ_ID, (uint8_t *)&NewPidCoeffs[1], sizeof(float)},
+	{PRP_PID_D_COEFF_OBJ_ID, (uint8_t *)&NewPidCoeffs[2], sizeof(float)},
+	{PRP_TARGET_VALUE_OBJ_ID, (uint8_t *)&NewTargetValue, sizeof(float)},
+	{PRP_CURRENT_VALUE_OBJ_ID, (uint8_t *)&NewTargetValue, sizeof(float)}};
+
+// Rarely changing objects read in deltas against their cached values.
+static Prp_Properties_t CachedProperties;
+static float CachedTargetValue;
+static ObjshareHost_CachedObject_t CachedObjects[] = {
+	{PRP_PROPERTIES_OBJ_ID, (uint8_t *)&CachedProperties, sizeof(CachedProperties)},
+	{PRP_TARGET_VALUE_OBJ_ID, (uint8_t *)&CachedTargetValue, sizeof(CachedTargetValue)}};
+
+// Slot state refreshed by reading only the objects changed since they were read last.
+static Prp_Properties_t VersionedProperties;
+static float VersionedValues[5];
+static ObjshareHost_VersionedObject_t VersionedObjects[] = {
+	{PRP_PROPERTIES_OBJ_ID, (uint8_t *)&VersionedProperties, sizeof(VersionedProperties)},
+	{PRP_TARGET_VALUE_OBJ_ID, (uint8_t *)&VersionedValues[0], sizeof(float)},
+	{PRP_CURRENT_VALUE_OBJ_ID, (uint8_t *)&VersionedValues[1], sizeof(float)},
+	{PRP_PID_I_COEFF_OBJ_ID, (uint8_t *)&VersionedValues[2], sizeof(float)},
+	{PRP_PID_K_COEFF_OBJ_ID, (uint8_t *)&VersionedValues[3], sizeof(float)},
+	{PRP_PID_D_COEFF_OBJ_ID, (uint8_t *)&VersionedValues[4], sizeof(float)}};
+
+// Slot state refreshed by reading, in one read multi, only the objects the journal lists as changed.
+static ObjshareHost_Changes_t SlotChanges;
+static ObjshareHost_ReadEntry_t ChangedEntries[OBJSHARE_PROTOCOL_MAX_CHANGE_COUNT];
+static float ChangedPidKCoeff = 3.0f;
+static float ChangedTargetValue = 185.0f;
+
+// Current value followed through notifications instead of polls.
+static ObjshareHost_Subscription_t CurrentValueSubscription = {PRP_CURRENT_VALUE_OBJ_ID, 5, 1.0f};
+
+/* Public function implementations. ------------------------------------------*/
+// Drives poll, write and read round trips against a peripheral and reports the
+//transaction rate. With -p, the peripheral binary is started on a fresh pty pair.
+int main(int argc, char **argv)
+{
+	const char *device = SERIAL_POSIX_DEFAULT_DEVICE;
+	const char *peripheral = 0;
+	const char *trace = 0;
+	uint32_t count = DEFAULT_TRANSACTION_COUNT;
+	pid_t child = -1;
+	int opt;
+
+#ifdef SERIAL_TEST
+	if (!Serial_Test())
+	{
+		fprintf(stderr, "serial test failed\n");
+		return EXIT_FAILURE;
+	}
+	printf("serial test passed\n");
+#endif
+
+#ifdef PACKET_MANAGER_TEST
+	if (!PacketManager_Test())
+	{
+		fprintf(stderr, "packet manager test failed\n");
+		return EXIT_FAILURE;
+	}
+	printf("packet manager test passed\n");
+#endif
+
+#if defined(SERIAL_TEST) || defined(PACKET_MANAGER_TEST)
+	return EXIT_SUCCESS;
+#endif
+
+	while ((opt = getopt(argc, argv, "d:p:n:t:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'd':
+			device = optarg;
+			break;
+
+		case 'p':
+			peripheral = optarg;
+			device = SERIAL_POSIX_PTY_MASTER;
+			break;
+
+		case 'n':
+			count = (uint32_t)strtoul(optarg, 0, 0);
+			break;
+
+		case 't':
+			trace = optarg;
+			break;
+
+		default:
+			fprintf(stderr, "usage: %s [-d device | -p peripheral] [-n count] [-t trace dump]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	ObjshareHost_Delegates_t delegates;
+
+	delegates.addressSlotDelegate = addressSlotEventHandler;
+	delegates.switchDirectionDelegate = switchDirectionEventHandler;
+	delegates.readResponseReceivedDelegate = readResponseReceivedEventHandler;
+	delegates.noResponseDelegate = noResponseEventHandler;
+	delegates.operationFailedDelegate = operationFailedEventHandler;
+	delegates.pollResponseReceivedDelegate = pollResponseReceivedEventHandler;
+	delegates.readMultiResponseReceivedDelegate = readMultiResponseReceivedEventHandler;
+	delegates.writeMultiResponseReceivedDelegate = writeMultiResponseReceivedEventHandler;
+	delegates.notificationReceivedDelegate = notificationReceivedEventHandler;
+	delegates.changesReceivedDelegate = changesReceivedEventHandler;
+
+	Serial_SetDevice(device);
+	ObjshareHost_Setup(&delegates);
+
+	ObjshareHost_Start();
+
+	if (peripheral)
+	{
+		if (!Serial_GetPtyName())
+		{
+			fprintf(stderr, "cannot allocate a pseudo-terminal\n");
+			return EXIT_FAILURE;
+		}
+
+		child = spawnPeripheral(peripheral);
+	}
+
+	int result = EXIT_FAILURE;
+
+	// Poll until the peripheral answers.
+	uint32_t sys_time = SysTime_GetTimeInMs();
+	PollResponse = FALSE;
+
+	while (!PollResponse && (SysTime_GetTimeInMs() - sys_time < CONNECT_TIMEOUT_IN_MS))
+	{
+		Failed = FALSE;
+		ObjshareHost_SendPollRequest(PRP_BED_SLOT);
+		waitFor(&PollResponse, TRANSACTION_TIMEOUT_IN_MS);
+	}
+
+	if (!PollResponse)
+	{
+		fprintf(stderr, "no poll response\n");
+		goto exit;
+	}
+
+	char name[PRP_MAX_NAME_LENGTH + 1] = {0};
+
+	ReadResponse = FALSE;
+	ObjshareHost_SendReadRequest(PRP_BED_SLOT, PRP_NAME_OBJ_ID, (uint8_t *)name, PRP_MAX_NAME_LENGTH);
+
+	if (!waitFor(&ReadResponse, TRANSACTION_TIMEOUT_IN_MS))
+	{
+		fprintf(stderr, "cannot read peripheral name\n");
+		goto exit;
+	}
+
+	printf("connected to %s\n", name);
+
+	// Write the target value and read it back; a read response ends each transaction.
+	sys_time = SysTime_GetTimeInMs();
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		float target_value = (float)i * 0.5f;
+		float read_value = -1.0f;
+
+		Failed = FALSE;
+		ReadResponse = FALSE;
+
+		ObjshareHost_SendWriteRequest(PRP_BED_SLOT, PRP_TARGET_VALUE_OBJ_ID,
+									  (uint8_t *)&target_value, sizeof(target_value));
+		ObjshareHost_SendReadRequest(PRP_BED_SLOT, PRP_TARGET_VALUE_OBJ_ID,
+									 (uint8_t *)&read_value, sizeof(read_value));
+
+		if (!waitFor(&ReadResponse, TRANSACTION_TIMEOUT_IN_MS) || (read_value != target_value))
+		{
+			fprintf(stderr, "transaction %u failed\n", (unsigned)i);
+			goto exit;
+		}
+	}
+
+	uint32_t elapsed = SysTime_GetTimeInMs() - sys_time;
+
+	printf("%u write/read transactions in %u ms", (unsigned)count, (unsigned)elapsed);
+	if (count)
+	{
+		printf(" (%u us per round trip)", (unsigned)((elapsed * 1000ULL) / (count * 2ULL)));
+	}
+	printf("\n");
+
+	// Write the calibration table and read it back.
+	for (uint16_t i = 0; i < PRP_CALIBRATION_TABLE_LENGTH; i++)
+	{
+		CalibrationTable[i] = (float)i * 0.25f;
+		CalibrationTableReadBack[i] = -1.0f;
+	}
+
+	sys_time = SysTime_GetTimeInMs();
+	Failed = FALSE;
+	ReadResponse = FALSE;
+
+	ObjshareHost_SendWriteRequest(PRP_BED_SLOT, PRP_CALIBRATION_TABLE_OBJ_ID,
+								  (uint8_t *)CalibrationTable, sizeof(CalibrationTable));
+	ObjshareHost_SendReadRequest(PRP_BED_SLOT, PRP_CALIBRATION_TABLE_OBJ_ID,
+								 (uint8_t *)CalibrationTableReadBack, sizeof(CalibrationTableReadBack));
+
+	if (!waitFor(&ReadResponse, TRANSACTION_TIMEOUT_IN_MS) ||
+		memcmp(CalibrationTable, CalibrationTableReadBack, sizeof(CalibrationTable)))
+	{
+		fprintf(stderr, "calibration table transfer failed\n");
+		goto exit;
+	}
+
+	printf("%u byte object written and read back in %u ms\n", (unsigned)sizeof(CalibrationTable),
+		   (unsigned)(SysTime_GetTimeInMs() - sys_time));
+
+	// Read of the head of the table gets one frame, and is pipelined with the poll behind it.
+	memset(CalibrationTableReadBack, 0, sizeof(CalibrationTableReadBack));
+	ObjshareHost_SetWindowSize(OBJSHARE_HOST_MAX_WINDOW_SIZE);
+	Failed = FALSE;
+	ReadResponse = FALSE;
+	PollResponse = FALSE;
+
+	ObjshareHost_SendReadRequest(PRP_BED_SLOT, PRP_CALIBRATION_TABLE_OBJ_ID,
+								 (uint8_t *)CalibrationTableReadBack, 2 * sizeof(float));
+	ObjshareHost_SendPollRequest(PRP_BED_SLOT);
+
+	if (!waitFor(&PollResponse, TRANSACTION_TIMEOUT_IN_MS) || !ReadResponse ||
+		memcmp(CalibrationTable, CalibrationTableReadBack, 2 * sizeof(float)) ||
+		(CalibrationTableReadBack[2] != 0.0f))
+	{
+		fprintf(stderr, "short calibration table read failed\n");
+		goto exit;
+	}
+
+	ObjshareHost_SetWindowSize(1);
+
+	// Change one entry of the table, then read a part of it back; a range past its end fails.
+	uint16_t range_first = 16;
+	uint16_t range_count = 64;
+
+	CalibrationTable[range_first + 1] = 99.0f;
+	Failed = FALSE;
+	ReadResponse = FALSE;
+
+	ObjshareHost_SendWriteRangeRequest(PRP_BED_SLOT, PRP_CALIBRATION_TABLE_OBJ_ID,
+									   (range_first + 1) * sizeof(float),
+									   (uint8_t *)&CalibrationTable[range_first + 1], sizeof(float));
+	ObjshareHost_SendReadRangeRequest(PRP_BED_SLOT, PRP_CALIBRATION_TABLE_OBJ_ID, range_first * sizeof(float),
+									  (uint8_t *)&CalibrationTableReadBack[range_first],
+									  range_count * sizeof(float));
+
+	if (!waitFor(&ReadResponse, TRANSACTION_TIMEOUT_IN_MS) ||
+		memcmp(&CalibrationTable[range_first], &CalibrationTableReadBack[range_first], range_count * sizeof(float)))
+	{
+		fprintf(stderr, "calibration table range transfer failed\n");
+		goto exit;
+	}
+
+	Failed = FALSE;
+	ReadResponse = FALSE;
+
+	ObjshareHost_SendReadRangeRequest(PRP_BED_SLOT, PRP_CALIBRATION_TABLE_OBJ_ID,
+									  (PRP_CALIBRATION_TABLE_LENGTH - 1) * sizeof(float),
+									  (uint8_t *)CalibrationTableReadBack, 2 * sizeof(float));
+
+	if (waitFor(&ReadResponse, TRANSACTION_TIMEOUT_IN_MS) || !Failed)
+	{
+		fprintf(stderr, "calibration table range past its end not refused\n");
+		goto exit;
+	}
+
+	printf("%u byte range written, %u byte range read back\n", (unsigned)sizeof(float),
+		   (unsigned)(range_count * sizeof(float)));
+
+	// Writes longer than the table, by as little as a byte, leave its contents, and its version,
+	//as they were.
+	uint16_t oversized_lengths[] = {sizeof(CalibrationTable) + 1, sizeof(OversizedTable)};
+
+	memset(OversizedTable, 0xA5, sizeof(OversizedTable));
+
+	for (uint8_t i = 0; i < (sizeof(oversized_lengths) / sizeof(oversized_lengths[0])); i++)
+	{
+		Failed = FALSE;
+		ChangesResponse = FALSE;
+
+		ObjshareHost_SendGetChangesRequest(PRP_BED_SLOT, &TableChanges);
+
+		if (!waitFor(&ChangesResponse, TRANSACTION_TIMEOUT_IN_MS))
+		{
+			fprintf(stderr, "get changes failed\n");
+			goto exit;
+		}
+
+		Failed = FALSE;
+		NoResponse = FALSE;
+		ChangesResponse = FALSE;
+
+		ObjshareHost_SendWriteRequest(PRP_BED_SLOT, PRP_CALIBRATION_TABLE_OBJ_ID, OversizedTable,
+									  oversized_lengths[i]);
+
+		// Refused with a response; a write lost on the way is not.
+		if (waitFor(&ChangesResponse, TRANSACTION_TIMEOUT_IN_MS) || !Failed || NoResponse)
+		{
+			fprintf(stderr, "oversized calibration table write not refused\n");
+			goto exit;
+		}
+
+		Failed = FALSE;
+		ChangesResponse = FALSE;
+
+		ObjshareHost_SendGetChangesRequest(PRP_BED_SLOT, &TableChanges);
+
+		if (!waitFor(&ChangesResponse, TRANSACTION_TIMEOUT_IN_MS) ||
+			memchr(TableChanges.objIds, PRP_CALIBRATION_TABLE_OBJ_ID, TableChanges.count))
+		{
+			fprintf(stderr, "oversized calibration table write changed its version\n");
+			goto exit;
+		}
+
+		memset(CalibrationTableReadBack, 0, sizeof(CalibrationTableReadBack));
+		Failed = FALSE;
+		ReadResponse = FALSE;
+
+		ObjshareHost_SendReadRequest(PRP_BED_SLOT, PRP_CALIBRATION_TABLE_OBJ_ID,
+									 (uint8_t *)CalibrationTableReadBack, sizeof(CalibrationTableReadBack));
+
+		if (!waitFor(&ReadResponse, TRANSACTION_TIMEOUT_IN_MS) ||
+			memcmp(CalibrationTable, CalibrationTableReadBack, sizeof(CalibrationTable)))
+		{
+			fprintf(stderr, "oversized calibration table write changed its contents\n");
+			goto exit;
+		}
+
+		printf("%u byte write into a %u byte object refused\n", (unsigned)oversized_lengths[i],
+			   (unsigned)sizeof(CalibrationTable));
+	}
+
+	// Refresh the slot's objects in one round trip each; the command point is not served.
+	uint8_t entry_count = sizeof(SlotEntries) / sizeof(SlotEntries[0]);
+	float last_target_value = (float)(count - 1) * 0.5f;
+
+	sys_time = SysTime_GetTimeInMs();
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		Failed = FALSE;
+		ReadResponse = FALSE;
+		TargetValue = -1.0f;
+
+		ObjshareHost_SendReadMultiRequest(PRP_BED_SLOT, SlotEntries, entry_count);
+
+		if (!waitFor(&ReadResponse, TRANSACTION_TIMEOUT_IN_MS) || strcmp(Name, name) ||
+			(TargetValue != last_target_value) ||
+			(SlotEntries[entry_count - 1].result != OPERATION_RESULT_FAILURE))
+		{
+			fprintf(stderr, "read multi %u failed\n", (unsigned)i);
+			goto exit;
+		}
+	}
+
+	elapsed = SysTime_GetTimeInMs() - sys_time;
+
+	printf("%u read multi of %u objects in %u ms", (unsigned)count, (unsigned)entry_count, (unsigned)elapsed);
+	if (count)
+	{
+		printf(" (%u us per round trip)", (unsigned)((elapsed * 1000ULL) / count));
+	}
+	printf("\n");
+
+	// Reconfigure the controller at once and read it back.
+	uint8_t controller_count = sizeof(ControllerEntries) / sizeof(ControllerEntries[0]);
+
+	Failed = FALSE;
+	WriteResponse = FALSE;
+	ReadResponse = FALSE;
+
+	ObjshareHost_SendWriteMultiRequest(PRP_BED_SLOT, ControllerEntries, controller_count);
+	ObjshareHost_SendReadMultiRequest(PRP_BED_SLOT, SlotEntries, entry_count);
+
+	if (!waitFor(&ReadResponse, TRANSACTION_TIMEOUT_IN_MS) || !WriteResponse ||
+		memcmp(PidCoeffs, NewPidCoeffs, sizeof(PidCoeffs)) || (TargetValue != NewTargetValue))
+	{
+		fprintf(stderr, "write multi failed\n");
+		goto exit;
+	}
+
+	for (uint8_t i = 0; i < controller_count; i++)
+	{
+		if (ControllerEntries[i].result != ((i < (controller_count - 1)) ? OPERATION_RESULT_SUCCESS
+																		  : OPERATION_RESULT_FAILURE))
+		{
+			fprintf(stderr, "write multi result %u is wrong\n", (unsigned)i);
+			goto exit;
+		}
+	}
+
+	printf("%u objects written in one write multi\n", (unsigned)controller_count);
+
+	// Same reads kept queued; stop-and-wait, then with the requests pipelined.
+	for (uint8_t window = 1; window; window = (window < OBJSHARE_HOST_MAX_WINDOW_SIZE) ? OBJSHARE_HOST_MAX_WINDOW_SIZE : 0)
+	{
+		ObjshareHost_SetWindowSize(window);
+		sys_time = SysTime_GetTimeInMs();
+
+		if (!readBurst(count))
+		{
+			fprintf(stderr, "reads with window %u failed\n", (unsigned)window);
+			goto exit;
+		}
+
+		elapsed = SysTime_GetTimeInMs() - sys_time;
+
+		printf("%u reads with window %u in %u ms", (unsigned)count, (unsigned)window, (unsigned)elapsed);
+		if (count)
+		{
+			printf(" (%u us per read)", (unsigned)((elapsed * 1000ULL) / count));
+		}
+		printf("\n");
+	}
+
+	ObjshareHost_SetWindowSize(1);
+
+	// Set the target value of every slot at once and confirm it on this one.
+	float broadcast_value = 42.5f;
+	float confirm_value = -1.0f;
+
+	Failed = FALSE;
+	ReadResponse = FALSE;
+
+	ObjshareHost_SendBroadcastWriteRequest(PRP_TARGET_VALUE_OBJ_ID, (uint8_t *)&broadcast_value,
+										   sizeof(broadcast_value));
+	ObjshareHost_SendReadRequest(PRP_BED_SLOT, PRP_TARGET_VALUE_OBJ_ID, (uint8_t *)&confirm_value,
+								 sizeof(confirm_value));
+
+	if (!waitFor(&ReadResponse, TRANSACTION_TIMEOUT_IN_MS) || (confirm_value != broadcast_value))
+	{
+		fprintf(stderr, "broadcast write failed\n");
+		goto exit;
+	}
+
+	printf("broadcast write confirmed\n");
+
+	// Move the target and follow the current value until it settles within the deadband.
+	float settle_value = 100.0f;
+
+	Failed = FALSE;
+	NotificationCount = 0;
+	NotifiedValue = broadcast_value;
+
+	ObjshareHost_SendSubscribeRequest(PRP_BED_SLOT, &CurrentValueSubscription);
+	ObjshareHost_SendWriteRequest(PRP_BED_SLOT, PRP_TARGET_VALUE_OBJ_ID, (uint8_t *)&settle_value,
+								  sizeof(settle_value));
+
+	sys_time = SysTime_GetTimeInMs();
+
+	while (((settle_value - NotifiedValue) >= CurrentValueSubscription.deadband) ||
+		   ((NotifiedValue - settle_value) >= CurrentValueSubscription.deadband))
+	{
+		if (Failed || (SysTime_GetTimeInMs() - sys_time > SETTLE_TIMEOUT_IN_MS))
+		{
+			fprintf(stderr, "subscription failed\n");
+			goto exit;
+		}
+
+		ObjshareHost_Execute();
+		sched_yield();
+	}
+
+	printf("current value settled at %.2f in %u ms after %u notifications\n", NotifiedValue,
+		   (unsigned)(SysTime_GetTimeInMs() - sys_time), (unsigned)NotificationCount);
+
+	// Broadcast leaves the current value moving unnotified until the slot is polled alone.
+	float held_value = settle_value + 50.0f;
+	uint32_t held_count = NotificationCount;
+	volatile Bool_t never = FALSE;
+
+	ObjshareHost_SendBroadcastWriteRequest(PRP_TARGET_VALUE_OBJ_ID, (uint8_t *)&held_value,
+										   sizeof(held_value));
+	waitFor(&never, SETTLE_TIMEOUT_IN_MS / 10);
+
+	if (Failed || (NotificationCount != held_count))
+	{
+		fprintf(stderr, "notification sent after broadcast\n");
+		goto exit;
+	}
+
+	PollResponse = FALSE;
+
+	ObjshareHost_SendPollRequest(PRP_BED_SLOT);
+
+	if (!waitFor(&PollResponse, TRANSACTION_TIMEOUT_IN_MS))
+	{
+		fprintf(stderr, "poll after broadcast failed\n");
+		goto exit;
+	}
+
+	sys_time = SysTime_GetTimeInMs();
+
+	while (NotificationCount == held_count)
+	{
+		if (Failed || (SysTime_GetTimeInMs() - sys_time > TRANSACTION_TIMEOUT_IN_MS))
+		{
+			fprintf(stderr, "notification not resumed after broadcast\n");
+			goto exit;
+		}
+
+		ObjshareHost_Execute();
+		sched_yield();
+	}
+
+	// Poll answered after the unsubscribe request; it has been taken.
+	PollResponse = FALSE;
+
+	ObjshareHost_SendUnsubscribeRequest(PRP_BED_SLOT, PRP_CURRENT_VALUE_OBJ_ID);
+	ObjshareHost_SendPollRequest(PRP_BED_SLOT);
+
+	if (!waitFor(&PollResponse, TRANSACTION_TIMEOUT_IN_MS))
+	{
+		fprintf(stderr, "unsubscribe failed\n");
+		goto exit;
+	}
+
+	// Poll the cached objects; the target value changes half way through.
+	uint8_t cached_count = sizeof(CachedObjects) / sizeof(CachedObjects[0]);
+	float delta_target_value = 150.0f;
+
+	sys_time = SysTime_GetTimeInMs();
+
+	for (uint32_t i = 0; i < DELTA_READ_COUNT; i++)
+	{
+		if (i == (DELTA_READ_COUNT / 2))
+		{
+			ObjshareHost_SendWriteRequest(PRP_BED_SLOT, PRP_TARGET_VALUE_OBJ_ID, (uint8_t *)&delta_target_value,
+										  sizeof(delta_target_value));
+		}
+
+		for (uint8_t j = 0; j < cached_count; j++)
+		{
+			Failed = FALSE;
+			ReadResponse = FALSE;
+
+			ObjshareHost_SendReadDeltaRequest(PRP_BED_SLOT, &CachedObjects[j]);
+
+			if (!waitFor(&ReadResponse, TRANSACTION_TIMEOUT_IN_MS))
+			{
+				fprintf(stderr, "delta read %u failed\n", (unsigned)i);
+				goto exit;
+			}
+		}
+	}
+
+	if (memcmp(&CachedProperties, &Properties, sizeof(Properties)) || (CachedTargetValue != delta_target_value))
+	{
+		fprintf(stderr, "delta read cache mismatch\n");
+		goto exit;
+	}
+
+	printf("%u delta reads of %u objects in %u ms\n", (unsigned)DELTA_READ_COUNT, (unsigned)cached_count,
+		   (unsigned)(SysTime_GetTimeInMs() - sys_time));
+
+	// Refresh the slot state by versions while the target value moves, and the current value with it.
+	uint8_t versioned_count = sizeof(VersionedObjects) / sizeof(VersionedObjects[0]);
+	uint32_t modified_count = 0;
+	float versioned_target_value = 175.0f;
+
+	sys_time = SysTime_GetTimeInMs();
+
+	for (uint32_t i = 0; i < VERSIONED_READ_COUNT; i++)
+	{
+		if (i == (VERSIONED_READ_COUNT / 2))
+		{
+			ObjshareHost_SendWriteRequest(PRP_BED_SLOT, PRP_TARGET_VALUE_OBJ_ID, (uint8_t *)&versioned_target_value,
+										  sizeof(versioned_target_value));
+		}
+
+		for (uint8_t j = 0; j < versioned_count; j++)
+		{
+			Failed = FALSE;
+			ReadResponse = FALSE;
+
+			ObjshareHost_SendReadIfChangedRequest(PRP_BED_SLOT, &VersionedObjects[j]);
+
+			if (!waitFor(&ReadResponse, TRANSACTION_TIMEOUT_IN_MS))
+			{
+				fprintf(stderr, "versioned read %u failed\n", (unsigned)i);
+				goto exit;
+			}
+
+			modified_count += VersionedObjects[j].isModified ? 1 : 0;
+		}
+	}
+
+	if (memcmp(&VersionedProperties, &Properties, sizeof(Properties)) ||
+		(VersionedValues[0] != versioned_target_value))
+	{
+		fprintf(stderr, "versioned read mismatch\n");
+		goto exit;
+	}
+
+	printf("%u versioned reads of %u objects in %u ms, %u modified\n", (unsigned)VERSIONED_READ_COUNT,
+		   (unsigned)versioned_count, (unsigned)(SysTime_GetTimeInMs() - sys_time), (unsigned)modified_count);
+
+	// First get changes lists every object; after two writes, only those and the current value
+	//following the target are stale.
+	Failed = FALSE;
+	ChangesResponse = FALSE;
+
+	ObjshareHost_SendGetChangesRequest(PRP_BED_SLOT, &SlotChanges);
+
+	if (!waitFor(&ChangesResponse, TRANSACTION_TIMEOUT_IN_MS) || !SlotChanges.count)
+	{
+		fprintf(stderr, "get all changes failed\n");
+		goto exit;
+	}
+
+	uint8_t all_count = SlotChanges.count;
+
+	Failed = FALSE;
+	ChangesResponse = FALSE;
+
+	ObjshareHost_SendWriteRequest(PRP_BED_SLOT, PRP_PID_K_COEFF_OBJ_ID, (uint8_t *)&ChangedPidKCoeff,
+								  sizeof(ChangedPidKCoeff));
+	ObjshareHost_SendWriteRequest(PRP_BED_SLOT, PRP_TARGET_VALUE_OBJ_ID, (uint8_t *)&ChangedTargetValue,
+								  sizeof(ChangedTargetValue));
+	ObjshareHost_SendGetChangesRequest(PRP_BED_SLOT, &SlotChanges);
+
+	if (!waitFor(&ChangesResponse, TRANSACTION_TIMEOUT_IN_MS))
+	{
+		fprintf(stderr, "get changes failed\n");
+		goto exit;
+	}
+
+	uint8_t changed_count = 0;
+
+	for (uint8_t i = 0; i < SlotChanges.count; i++)
+	{
+		for (uint8_t j = 0; j < entry_count; j++)
+		{
+			if (SlotEntries[j].objId == SlotChanges.objIds[i])
+			{
+				ChangedEntries[changed_count++] = SlotEntries[j];
+			}
+		}
+	}
+
+	Failed = FALSE;
+	ReadResponse = FALSE;
+
+	changed_count ? ObjshareHost_SendReadMultiRequest(PRP_BED_SLOT, ChangedEntries, changed_count) : (void)0;
+
+	if (!changed_count || !waitFor(&ReadResponse, TRANSACTION_TIMEOUT_IN_MS) ||
+		(PidCoeffs[1] != ChangedPidKCoeff) || (TargetValue != ChangedTargetValue))
+	{
+		fprintf(stderr, "changed objects read failed\n");
+		goto exit;
+	}
+
+	printf("%u of %u objects changed, read in one read multi\n", (unsigned)SlotChanges.count,
+		   (unsigned)all_count);
+
+	// Changes no longer in the journal list every object, however few of them actually changed.
+	for (uint32_t i = 0; i < JOURNAL_OVERFLOW_WRITE_COUNT; i++)
+	{
+		float pid_d_coeff = (float)i * 0.125f;
+
+		Failed = FALSE;
+		PollResponse = FALSE;
+
+		ObjshareHost_SendWriteRequest(PRP_BED_SLOT, PRP_PID_D_COEFF_OBJ_ID, (uint8_t *)&pid_d_coeff,
+									  sizeof(pid_d_coeff));
+		ObjshareHost_SendPollRequest(PRP_BED_SLOT);
+
+		if (!waitFor(&PollResponse, TRANSACTION_TIMEOUT_IN_MS))
+		{
+			fprintf(stderr, "journal overflow write %u failed\n", (unsigned)i);
+			goto exit;
+		}
+	}
+
+	Failed = FALSE;
+	ChangesResponse = FALSE;
+
+	ObjshareHost_SendGetChangesRequest(PRP_BED_SLOT, &SlotChanges);
+
+	if (!waitFor(&ChangesResponse, TRANSACTION_TIMEOUT_IN_MS) || (SlotChanges.count != all_count))
+	{
+		fprintf(stderr, "get changes after journal overflow failed\n");
+		goto exit;
+	}
+
+	printf("%u objects listed after %u writes past the journal\n", (unsigned)SlotChanges.count,
+		   (unsigned)JOURNAL_OVERFLOW_WRITE_COUNT);
+
+#ifdef PACKET_MANAGER_STATS
+	PacketManager_Stats_t stats;
+
+	PacketManager_GetStats(&stats);
+	printf("rx %u frames, %u crc errors, %u overflows, %u escapes; tx %u frames, %u queue full, %u escapes\n",
+		   (unsigned)stats.rxFrames, (unsigned)stats.rxCrcErrors, (unsigned)stats.rxOverflows,
+		   (unsigned)stats.rxEscapes, (unsigned)stats.txFrames, (unsigned)stats.txQueueFull,
+		   (unsigned)stats.txEscapes);
+#endif
+#ifdef OBJSHARE_HOST_LATENCY
+	static const char *request_names[OBJSHARE_HOST_REQUEST_COUNT] = {"read", "write", "poll", "read multi",
+																   "write multi", "broadcast write", "subscribe",
+																   "read range", "write range", "read delta",
+																   "read if changed", "get changes"};
+	static const char *phase_names[OBJSHARE_HOST_LATENCY_PHASE_COUNT] = {"queue", "wire", "turnaround"};
+	static ObjshareHost_Latency_t latency;
+
+	ObjshareHost_GetLatency(&latency);
+
+	for (uint8_t i = 0; i < OBJSHARE_HOST_REQUEST_COUNT; i++)
+	{
+		for (uint8_t j = 0; j < OBJSHARE_HOST_LATENCY_PHASE_COUNT; j++)
+		{
+			ObjshareHost_LatencyHistogram_t *histogram = &latency.byRequest[j][i];
+
+			if (histogram->count)
+			{
+				printf("%s %s: %u samples, p50 %u us, p99 %u us, max %u us\n", request_names[i],
+					   phase_names[j], (unsigned)histogram->count,
+					   (unsigned)ObjshareHost_GetLatencyPercentile(histogram, 50),
+					   (unsigned)ObjshareHost_GetLatencyPercentile(histogram, 99), (unsigned)histogram->max);
+			}
+		}
+	}
+#endif
+#ifdef SERIAL_STATS
+	Serial_Stats_t serial_stats;
+
+	Serial_GetStats(&serial_stats);
+	printf("serial rx %u bytes, tx %u bytes, %u errors, %u restarts\n", (unsigned)serial_stats.rxBytes,
+		   (unsigned)serial_stats.txBytes, (unsigned)serial_stats.errors, (unsigned)serial_stats.restarts);
+#endif
+
+	result = EXIT_SUCCESS;
+
+exit:
+	ObjshareHost_Stop();
+
+	if (trace)
+	{
+		dumpTrace(trace);
+	}
+
+	if (child > 0)
+	{
+		kill(child, SIGTERM);
+		waitpid(child, 0, 0);
+	}
+
+	return result;
+}
+
+/* Private function implementations ------------------------------------------*/
+static pid_t spawnPeripheral(const char *path)
+{
+	const char *pty = Serial_GetPtyName();
+	pid_t pid = fork();
+
+	if (pid == 0)
+	{
+		execl(path, path, "-d", pty, (char *)0);
+		_exit(EXIT_FAILURE);
+	}
+
+	return pid;
+}
+
+static Bool_t waitFor(volatile Bool_t *flag, uint32_t timeout)
+{
+	uint32_t sys_time = SysTime_GetTimeInMs();
+
+	while (!*flag && !Failed)
+	{
+		if (SysTime_GetTimeInMs() - sys_time > timeout)
+		{
+			return FALSE;
+		}
+
+		ObjshareHost_Execute();
+		sched_yield();
+	}
+
+	return *flag;
+}
+
+// Keeps reads of the current value queued until the given number of them are answered.
+static Bool_t readBurst(uint32_t count)
+{
+	uint32_t sent = 0;
+	uint32_t received = 0;
+	uint32_t sys_time = SysTime_GetTimeInMs();
+
+	Failed = FALSE;
+	ReadResponseCount = 0;
+
+	while (ReadResponseCount < count)
+	{
+		while ((sent < count) && ((sent - ReadResponseCount) < BURST_QUEUE_DEPTH))
+		{
+			ObjshareHost_SendReadRequest(PRP_BED_SLOT, PRP_CURRENT_VALUE_OBJ_ID, (uint8_t *)&CurrentValue,
+										 sizeof(CurrentValue));
+			sent++;
+		}
+
+		// Timeout is restarted by every response.
+		if (ReadResponseCount != received)
+		{
+			received = ReadResponseCount;
+			sys_time = SysTime_GetTimeInMs();
+		}
+
+		if (Failed || (SysTime_GetTimeInMs() - sys_time > TRANSACTION_TIMEOUT_IN_MS))
+		{
+			return FALSE;
+		}
+
+		ObjshareHost_Execute();
+		sched_yield();
+	}
+
+	return TRUE;
+}
+
+// Writes the trace ring for Tools/trace_decode; empty unless built with TRACE_ENABLE.
+static void dumpTrace(const char *path)
+{
+	Trace_DumpHeader_t header;
+	const Trace_Record_t *ring = Trace_GetRing(&header);
+	FILE *file = fopen(path, "wb");
+
+	if (!file)
+	{
+		fprintf(stderr, "cannot open %s\n", path);
+		return;
+	}
+
+	fwrite(&header, sizeof(header), 1, file);
+	header.length ? (void)fwrite(ring, sizeof(*ring), header.length, file) : (void)0;
+	fclose(file);
+}
+
+static void addressSlotEventHandler(uint8_t slot)
+{
+	// Single peripheral on the line; nothing to address.
+}
+
+static void switchDirectionEventHandler(ObjshareProtocol_Direction_t direction)
+{
+	// Full duplex line; no transceiver to switch.
+}
+
+static void readResponseReceivedEventHandler(uint8_t slot, uint8_t objId)
+{
+	ReadResponse = TRUE;
+	ReadResponseCount++;
+}
+
+static void noResponseEventHandler(uint8_t slot)
+{
+	Failed = TRUE;
+	NoResponse = TRUE;
+}
+
+static void operationFailedEventHandler(uint8_t slot)
+{
+	Failed = TRUE;
+}
+
+static void pollResponseReceivedEventHandler(uint8_t slot)
+{
+	PollResponse = TRUE;
+}
+
+static void readMultiResponseReceivedEventHandler(uint8_t slot, ObjshareHost_ReadEntry_t *entries,
+												  uint8_t count)
+{
+	ReadResponse = TRUE;
+}
+
+static void writeMultiResponseReceivedEventHandler(uint8_t slot, ObjshareHost_WriteEntry_t *entries,
+												   uint8_t count)
+{
+	WriteResponse = TRUE;
+}
+
+static void notificationReceivedEventHandler(uint8_t slot, uint8_t objId, uint8_t *data,
+											 uint16_t dataLength)
+{
+	if ((objId == PRP_CURRENT_VALUE_OBJ_ID) && (dataLength == sizeof(NotifiedValue)))
+	{
+		memcpy(&NotifiedValue, data, sizeof(NotifiedValue));
+		NotificationCount++;
+	}
+}
+
+static void changesReceivedEventHandler(uint8_t slot, ObjshareHost_Changes_t *changes)
+{
+	ChangesResponse = TRUE;
+}
@@ -1,7 +1,9 @@
+#include <string.h>
 #include "objshare_host.h"
 #include "objshare_protocol.h"
 #include "sys_time.h"
 #include "peripheral.h"
+#include "trace.h"
 #include "sys_time.h"
 
 /* Private constants ---------------------------------------------------------*/
@@ -17,51 +19,122 @@ enum
 {
 	PROCESS_CODE_READ_REQ = 0,
 	PROCESS_CODE_WRITE_REQ,
-	PROCESS_CODE_POLL_REQ
+	PROCESS_CODE_POLL_REQ,
+	PROCESS_CODE_READ_MULTI_REQ,
+	PROCESS_CODE_WRITE_MULTI_REQ,
+	PROCESS_CODE_BROADCAST_WRITE_REQ,
+	PROCESS_CODE_SUBSCRIBE_REQ,
+	PROCESS_CODE_READ_RANGE_REQ,
+	PROCESS_CODE_WRITE_RANGE_REQ,
+	PROCESS_CODE_READ_DELTA_REQ,
+	PROCESS_CODE_READ_IF_CHANGED_REQ,
+	PROCESS_CODE_GET_CHANGES_REQ
 };
 typedef uint8_t ProcessCode_t;
 
+// Multi requests keep their entries in data and their count in data length; subscribe request
+//keeps its subscription in data, 0 to unsubscribe. Range requests keep the offset of the range
+//within the object. Read delta and read if changed requests keep their objects in data, get
+//changes request its changes.
 typedef struct
 {
 	uint8_t slot;
 	uint8_t code;
 	uint8_t objId;
 	uint16_t dataLength;
+	uint16_t offset;
 	uint8_t *data;
+#ifdef OBJSHARE_HOST_LATENCY
+	uint32_t enqueueTimestamp;
+#endif
 } Process_t;
 
+// Request sent and waiting for its response; the response carries its sequence number.
+typedef struct
+{
+	Process_t process;
+	Bool_t isWaiting;
+	uint8_t sequence;
+	uint8_t retryCount;
+	uint32_t timestamp;
+#ifdef OBJSHARE_HOST_LATENCY
+	// Microseconds.
+	uint32_t sentTimestamp;
+	uint32_t outTimestamp;
+	Bool_t isOut;
+#endif
+} Request_t;
+
 /* Private function declarations ---------------------------------------------*/
-static void process(Process_t *process);
+static void process(Request_t *request);
+static Request_t *getRequest(uint8_t sequence);
+static void releaseRequest(Request_t *request);
+static Bool_t isExclusive(Process_t *process);
+static void enqueue(Process_t *process);
 static void pduReceivedEventHandler(ObjshareProtocol_PduType_t pduType,
 									OperationResult_t operationResult,
 									uint16_t unparsedPduSize);
+static void switchDirectionEventHandler(ObjshareProtocol_Direction_t direction);
+static void scatterMulti(Process_t *process, uint16_t length);
+static uint16_t gatherMulti(Process_t *process);
+static void setMultiResults(Process_t *process, uint8_t *results);
+static Bool_t applyDelta(ObjshareHost_CachedObject_t *object, uint8_t slot, uint16_t length);
+static Bool_t decodeDelta(uint8_t *value, uint16_t length, uint8_t *delta, uint16_t deltaLength);
+#ifdef OBJSHARE_HOST_LATENCY
+static void recordLatency(ObjshareHost_LatencyPhase_t phase, Process_t *process, uint32_t latency);
+static void addLatencySample(ObjshareHost_LatencyHistogram_t *histogram, uint32_t latency);
+static uint8_t getLatencyBucket(uint32_t latency);
+static uint32_t getLatencyBucketValue(uint8_t bucket);
+#endif
 
 #ifdef OBJSHARE_HOST_TEST
 static void testReadResponseReceivedEventHandler(uint8_t slot, uint8_t objId);
 static void testNoResponseEventHandler(uint8_t slot);
 static void testOperationFailedEventHandler(uint8_t slot);
 static void testPollResponseReceivedEventHandler(uint8_t);
+static void testReadMultiResponseReceivedEventHandler(uint8_t slot, ObjshareHost_ReadEntry_t *entries,
+													  uint8_t count);
+static void testWriteMultiResponseReceivedEventHandler(uint8_t slot, ObjshareHost_WriteEntry_t *entries,
+													   uint8_t count);
 #endif
 /* Private variables ---------------------------------------------------------*/
 // Variables to store module control data.
 static ObjshareHost_State_t State = OBJSHARE_HOST_STATE_UNINIT;
-static Bool_t WaitingResponse;
 
-static Process_t Cache;
-static uint32_t SuccessiveRequestCount;
-static uint32_t LastRequestTimestamp;
+// Requests waiting for their responses; all to the same slot.
+static Request_t Window[OBJSHARE_HOST_MAX_WINDOW_SIZE];
+static uint8_t WindowSize = 1;
+static uint8_t WindowCount;
+static uint8_t WindowSlot;
+static Bool_t WindowExclusive;
+static uint8_t NextSequence;
 
 // Delegates.
 static ObjshareHost_ReadResponseReceivedDelegate_t ReadResponseReceivedDelegate;
 static ObjshareHost_OperationFailedDelegate_t OperationFailedDelegate;
 static ObjshareHost_NoResponseDelegate_t NoResponseDelegate;
 static ObjshareHost_PollResponseDelegate_t PollResponseReceivedDelegate;
+static ObjshareHost_ReadMultiResponseReceivedDelegate_t ReadMultiResponseReceivedDelegate;
+static ObjshareHost_WriteMultiResponseReceivedDelegate_t WriteMultiResponseReceivedDelegate;
+static ObjshareHost_NotificationReceivedDelegate_t NotificationReceivedDelegate;
+static ObjshareHost_ChangesReceivedDelegate_t ChangesReceivedDelegate;
 static ObjshareHost_AddressSlotDelegate_t AddressSlotDelegate;
+static ObjshareProtocol_SwitchDirectionDelegate_t SwitchDirectionDelegate;
 
 // Containers.
 static Process_t ProcessQueueContainer[MAX_PENDING_PROCESS_COUNT];
 static QueueGeneric_Buffer_t ProcessQueue;
 
+// Object ids of the read multi request being sent, and the response of it, or of a read delta,
+//read if changed or get changes request, being received. Write multi and write range requests, and parameters of the subscribe
+//request, are gathered into the buffer while being sent.
+static uint8_t MultiIds[OBJSHARE_PROTOCOL_MAX_MULTI_COUNT];
+static uint8_t MultiBuffer[OBJSHARE_PROTOCOL_MAX_MULTI_DATA_SIZE];
+
+#ifdef OBJSHARE_HOST_LATENCY
+static ObjshareHost_Latency_t Latency;
+#endif
+
 #ifdef OBJSHARE_HOST_TEST
 static float TargetValue[TEST_SLOT_COUNT];
 static Bool_t PollResponse[TEST_SLOT_COUNT];
@@ -85,6 +158,10 @@ void ObjshareHost_Test(ObjshareHost_AddressSlotDelegate_t addressSlotEventHandle
 	delegates.noResponseDelegate = testNoResponseEventHandler;
 	delegates.operationFailedDelegate = testOperationFailedEventHandler;
 	delegates.pollResponseReceivedDelegate = testPollResponseReceivedEventHandler;
+	delegates.readMultiResponseReceivedDelegate = testReadMultiResponseReceivedEventHandler;
+	delegates.writeMultiResponseReceivedDelegate = testWriteMultiResponseReceivedEventHandler;
+	delegates.notificationReceivedDelegate = 0;
+	delegates.changesReceivedDelegate = 0;
 
 	ObjshareHost_Setup(&delegates);
 
@@ -213,18 +290,34 @@ void testPollResponseReceivedEventHandler(uint8_t slot)
 	PollResponse[slot] = TRUE;
 }
 
+void testReadMultiResponseReceivedEventHandler(uint8_t slot, ObjshareHost_ReadEntry_t *entries,
+											   uint8_t count)
+{
+	ReadResponse[slot] = TRUE;
+}
+
+void testWriteMultiResponseReceivedEventHandler(uint8_t slot, ObjshareHost_WriteEntry_t *entries,
+												uint8_t count)
+{
+}
+
 #endif
 
 void ObjshareHost_Setup(ObjshareHost_Delegates_t *delegates)
 {
-	ObjshareProtocol_Setup(pduReceivedEventHandler, delegates->switchDirectionDelegate);
+	ObjshareProtocol_Setup(pduReceivedEventHandler, switchDirectionEventHandler);
 
 	// Set delegates.
 	ReadResponseReceivedDelegate = delegates->readResponseReceivedDelegate;
 	OperationFailedDelegate = delegates->operationFailedDelegate;
 	NoResponseDelegate = delegates->noResponseDelegate;
 	PollResponseReceivedDelegate = delegates->pollResponseReceivedDelegate;
+	ReadMultiResponseReceivedDelegate = delegates->readMultiResponseReceivedDelegate;
+	WriteMultiResponseReceivedDelegate = delegates->writeMultiResponseReceivedDelegate;
+	NotificationReceivedDelegate = delegates->notificationReceivedDelegate;
+	ChangesReceivedDelegate = delegates->changesReceivedDelegate;
 	AddressSlotDelegate = delegates->addressSlotDelegate;
+	SwitchDirectionDelegate = delegates->switchDirectionDelegate;
 
 	// Init process queue.
 	QueueGeneric_InitBuffer(&ProcessQueue, ProcessQueueContainer,
@@ -242,7 +335,8 @@ Bool_t ObjshareHost_Start(void)
 	AddressSlotDelegate ? AddressSlotDelegate(0xFF) : (void)0;
 
 	// Set state variables.
-	WaitingResponse = FALSE;
+	memset(Window, 0, sizeof(Window));
+	WindowCount = 0;
 
 	// Set state to operating.
 	State = OBJSHARE_HOST_STATE_OPERATING;
@@ -262,39 +356,87 @@ void ObjshareHost_Execute(void)
 
 	uint32_t sys_time = SysTime_GetTimeInMs();
 
-	if (WaitingResponse)
+	// No response is due before the last fragment of the requests is out.
+	Bool_t is_sending = ObjshareProtocol_GetPendingFragmentCount() ? TRUE : FALSE;
+
+	for (uint8_t i = 0; i < OBJSHARE_HOST_MAX_WINDOW_SIZE; i++)
 	{
-		Bool_t no_response = FALSE;
+		Request_t *request = &Window[i];
+
+		if (!request->isWaiting)
+		{
+			continue;
+		}
+
+		if (is_sending)
+		{
+			request->timestamp = sys_time;
+			continue;
+		}
 
 		// Check for timeout.
-		if ((sys_time - LastRequestTimestamp) > OBJSHARE_HOST_TIMEOUT_IN_MS)
+		if ((sys_time - request->timestamp) > OBJSHARE_HOST_TIMEOUT_IN_MS)
 		{
-			if (++SuccessiveRequestCount > OBJSHARE_HOST_MAX_SUCCESSIVE_REQUESTS)
-			{
-				no_response = TRUE;
-			}
+			TRACE(TRACE_EVENT_REQUEST_TIMEOUT, request->process.slot, request->retryCount);
 
-			// Reprocess the request if successive request limit has not been exceeded.
-			if (no_response)
+			// Resend the request if successive request limit has not been exceeded.
+			if (++request->retryCount > OBJSHARE_HOST_MAX_SUCCESSIVE_REQUESTS)
 			{
-				WaitingResponse = FALSE;
-				NoResponseDelegate ? NoResponseDelegate(Cache.slot) : (void)0;
+				request->isWaiting = FALSE;
+				WindowCount--;
+				NoResponseDelegate ? NoResponseDelegate(request->process.slot) : (void)0;
 			}
 			else
 			{
-				process(&Cache);
+				// Response may be lost along with the value the peripheral keeps for the delta;
+				//have the whole value sent.
+				if (request->process.code == PROCESS_CODE_READ_DELTA_REQ)
+				{
+					((ObjshareHost_CachedObject_t *)request->process.data)->baseline = 0;
+				}
+
+				process(request);
+				is_sending = ObjshareProtocol_GetPendingFragmentCount() ? TRUE : FALSE;
 			}
 		}
 	}
-	else
+
+	// Send pending requests while the window has room. Window holds the requests of one slot;
+	//a fragmented or multi request goes alone.
+	while ((WindowCount < WindowSize) && QueueGeneric_GetElementCount(&ProcessQueue) && !is_sending)
 	{
-		// If any request pending; process it.
-		if (QueueGeneric_GetElementCount(&ProcessQueue))
+		Process_t *next = (Process_t *)QueueGeneric_GetPtr(&ProcessQueue, 0);
+
+		if (WindowCount && ((next->slot != WindowSlot) || WindowExclusive || isExclusive(next)))
+		{
+			break;
+		}
+
+		// Window has room; take a free entry.
+		Request_t *request = Window;
+
+		while (request->isWaiting)
 		{
-			QueueGeneric_Dequeue(&ProcessQueue, &Cache);
-			process(&Cache);
-			SuccessiveRequestCount = 0;
+			request++;
 		}
+
+		QueueGeneric_Dequeue(&ProcessQueue, &request->process);
+		next = &request->process;
+
+		TRACE(TRACE_EVENT_REQUEST_DEQUEUE, next->slot, ((uint16_t)next->code << 8) | next->objId);
+#ifdef OBJSHARE_HOST_LATENCY
+		recordLatency(OBJSHARE_HOST_LATENCY_QUEUE, next, SysTime_GetTimeInUs() - next->enqueueTimestamp);
+#endif
+		request->isWaiting = TRUE;
+		request->sequence = NextSequence++;
+		request->retryCount = 0;
+
+		WindowCount++;
+		WindowSlot = next->slot;
+		WindowExclusive = isExclusive(next);
+
+		process(request);
+		is_sending = ObjshareProtocol_GetPendingFragmentCount() ? TRUE : FALSE;
 	}
 }
 
@@ -317,6 +459,12 @@ ObjshareHost_State_t ObjshareHost_GetState(void)
 	return State;
 }
 
+void ObjshareHost_SetWindowSize(uint8_t size)
+{
+	WindowSize = (size > OBJSHARE_HOST_MAX_WINDOW_SIZE) ? OBJSHARE_HOST_MAX_WINDOW_SIZE : size;
+	WindowSize = WindowSize ? WindowSize : 1;
+}
+
 void ObjshareHost_SendReadRequest(uint8_t slot,
 								  uint8_t objId, uint8_t *data, uint16_t maxLength)
 {
@@ -328,7 +476,7 @@ void ObjshareHost_SendReadRequest(uint8_t slot,
 	process.data = data;
 	process.dataLength = maxLength;
 
-	QueueGeneric_Enqueue(&ProcessQueue, &process);
+	enqueue(&process);
 }
 
 void ObjshareHost_SendWriteRequest(uint8_t slot,
@@ -342,7 +490,7 @@ void ObjshareHost_SendWriteRequest(uint8_t slot,
 	process.data = data;
 	process.dataLength = dataLength;
 
-	QueueGeneric_Enqueue(&ProcessQueue, &process);
+	enqueue(&process);
 }
 
 void ObjshareHost_SendPollRequest(uint8_t slot)
@@ -351,13 +499,220 @@ void ObjshareHost_SendPollRequest(uint8_t slot)
 
 	process.slot = slot;
 	process.code = PROCESS_CODE_POLL_REQ;
+	process.objId = 0;
+
+	enqueue(&process);
+}
+
+void ObjshareHost_SendReadRangeRequest(uint8_t slot, uint8_t objId, uint16_t offset,
+									   uint8_t *data, uint16_t length)
+{
+	Process_t process;
+
+	process.slot = slot;
+	process.code = PROCESS_CODE_READ_RANGE_REQ;
+	process.objId = objId;
+	process.offset = offset;
+	process.data = data;
+	process.dataLength = length;
+
+	enqueue(&process);
+}
+
+void ObjshareHost_SendWriteRangeRequest(uint8_t slot, uint8_t objId, uint16_t offset,
+										uint8_t *data, uint16_t length)
+{
+	Process_t process;
+
+	if (length > (OBJSHARE_PROTOCOL_MAX_MULTI_DATA_SIZE - OBJSHARE_PROTOCOL_RANGE_OFFSET_SIZE))
+	{
+		return;
+	}
+
+	process.slot = slot;
+	process.code = PROCESS_CODE_WRITE_RANGE_REQ;
+	process.objId = objId;
+	process.offset = offset;
+	process.data = data;
+	process.dataLength = length;
 
-	QueueGeneric_Enqueue(&ProcessQueue, &process);
+	enqueue(&process);
 }
 
+void ObjshareHost_SendReadDeltaRequest(uint8_t slot, ObjshareHost_CachedObject_t *object)
+{
+	Process_t process;
+
+	process.slot = slot;
+	process.code = PROCESS_CODE_READ_DELTA_REQ;
+	process.objId = object->objId;
+	process.data = (uint8_t *)object;
+	process.dataLength = 0;
+
+	enqueue(&process);
+}
+
+void ObjshareHost_SendReadIfChangedRequest(uint8_t slot, ObjshareHost_VersionedObject_t *object)
+{
+	Process_t process;
+
+	process.slot = slot;
+	process.code = PROCESS_CODE_READ_IF_CHANGED_REQ;
+	process.objId = object->objId;
+	process.data = (uint8_t *)object;
+	process.dataLength = 0;
+
+	enqueue(&process);
+}
+
+void ObjshareHost_SendGetChangesRequest(uint8_t slot, ObjshareHost_Changes_t *changes)
+{
+	Process_t process;
+
+	process.slot = slot;
+	process.code = PROCESS_CODE_GET_CHANGES_REQ;
+	process.objId = 0;
+	process.data = (uint8_t *)changes;
+	process.dataLength = 0;
+
+	enqueue(&process);
+}
+
+void ObjshareHost_SendReadMultiRequest(uint8_t slot, ObjshareHost_ReadEntry_t *entries, uint8_t count)
+{
+	Process_t process;
+
+	if (!count || (count > OBJSHARE_PROTOCOL_MAX_MULTI_COUNT))
+	{
+		return;
+	}
+
+	process.slot = slot;
+	process.code = PROCESS_CODE_READ_MULTI_REQ;
+	process.objId = entries[0].objId;
+	process.data = (uint8_t *)entries;
+	process.dataLength = count;
+
+	enqueue(&process);
+}
+
+void ObjshareHost_SendWriteMultiRequest(uint8_t slot, ObjshareHost_WriteEntry_t *entries, uint8_t count)
+{
+	Process_t process;
+	uint32_t length = 0;
+
+	if (!count || (count > OBJSHARE_PROTOCOL_MAX_MULTI_COUNT))
+	{
+		return;
+	}
+
+	for (uint8_t i = 0; i < count; i++)
+	{
+		length += OBJSHARE_PROTOCOL_MULTI_WRITE_HEADER_SIZE + entries[i].dataLength;
+	}
+
+	if (length > OBJSHARE_PROTOCOL_MAX_MULTI_DATA_SIZE)
+	{
+		return;
+	}
+
+	process.slot = slot;
+	process.code = PROCESS_CODE_WRITE_MULTI_REQ;
+	process.objId = entries[0].objId;
+	process.data = (uint8_t *)entries;
+	process.dataLength = count;
+
+	enqueue(&process);
+}
+
+void ObjshareHost_SendBroadcastWriteRequest(uint8_t objId, uint8_t *data, uint16_t dataLength)
+{
+	Process_t process;
+
+	process.slot = OBJSHARE_HOST_BROADCAST_SLOT;
+	process.code = PROCESS_CODE_BROADCAST_WRITE_REQ;
+	process.objId = objId;
+	process.data = data;
+	process.dataLength = dataLength;
+
+	enqueue(&process);
+}
+
+void ObjshareHost_SendSubscribeRequest(uint8_t slot, ObjshareHost_Subscription_t *subscription)
+{
+	Process_t process;
+
+	process.slot = slot;
+	process.code = PROCESS_CODE_SUBSCRIBE_REQ;
+	process.objId = subscription->objId;
+	process.data = (uint8_t *)subscription;
+	process.dataLength = 0;
+
+	enqueue(&process);
+}
+
+void ObjshareHost_SendUnsubscribeRequest(uint8_t slot, uint8_t objId)
+{
+	Process_t process;
+
+	process.slot = slot;
+	process.code = PROCESS_CODE_SUBSCRIBE_REQ;
+	process.objId = objId;
+	process.data = 0;
+	process.dataLength = 0;
+
+	enqueue(&process);
+}
+
+#ifdef OBJSHARE_HOST_LATENCY
+void ObjshareHost_GetLatency(ObjshareHost_Latency_t *latency)
+{
+	// Updated from the main loop only.
+	memcpy(latency, &Latency, sizeof(Latency));
+}
+
+void ObjshareHost_ResetLatency(void)
+{
+	memset(&Latency, 0, sizeof(Latency));
+}
+
+uint32_t ObjshareHost_GetLatencyPercentile(const ObjshareHost_LatencyHistogram_t *histogram,
+										   uint8_t percent)
+{
+	uint64_t rank = ((uint64_t)histogram->count * percent + 99U) / 100U;
+	uint64_t cumulative = 0;
+
+	for (uint8_t i = 0; i < (OBJSHARE_HOST_LATENCY_BUCKET_COUNT - 1); i++)
+	{
+		cumulative += histogram->buckets[i];
+
+		if (cumulative && (cumulative >= rank))
+		{
+			uint32_t value = getLatencyBucketValue(i + 1) - 1;
+
+			return (value < histogram->max) ? value : histogram->max;
+		}
+	}
+
+	return histogram->max;
+}
+#endif
+
 /* Private function implementations ------------------------------------------*/
-static void process(Process_t *process)
+static void enqueue(Process_t *process)
+{
+#ifdef OBJSHARE_HOST_LATENCY
+	process->enqueueTimestamp = SysTime_GetTimeInUs();
+#endif
+	TRACE(TRACE_EVENT_REQUEST_ENQUEUE, process->slot, ((uint16_t)process->code << 8) | process->objId);
+
+	QueueGeneric_Enqueue(&ProcessQueue, process);
+}
+
+static void process(Request_t *request)
 {
+	Process_t *process = &request->process;
+
 	// Address related slot.
 	AddressSlotDelegate(process->slot);
 
@@ -365,16 +720,20 @@ static void process(Process_t *process)
 	{
 	case PROCESS_CODE_READ_REQ:
 	{
+		// Response is cut to the max length, which decides whether the request goes alone.
+		uint8_t max_length[OBJSHARE_PROTOCOL_READ_PARAMETERS_SIZE] = {(uint8_t)process->dataLength,
+																	  (uint8_t)(process->dataLength >> 8)};
+
 		ObjshareProtocol_Send(process->slot,
-							  OBJSHARE_PROTOCOL_PDUTYPE_READ_REQ,
-							  process->objId, 0, 0);
+							  OBJSHARE_PROTOCOL_PDUTYPE_READ_REQ, request->sequence,
+							  process->objId, max_length, sizeof(max_length));
 	}
 	break;
 
 	case PROCESS_CODE_WRITE_REQ:
 	{
 		ObjshareProtocol_Send(process->slot,
-							  OBJSHARE_PROTOCOL_PDUTYPE_WRITE_REQ,
+							  OBJSHARE_PROTOCOL_PDUTYPE_WRITE_REQ, request->sequence,
 							  process->objId,
 							  process->data, process->dataLength);
 	}
@@ -383,30 +742,223 @@ static void process(Process_t *process)
 	case PROCESS_CODE_POLL_REQ:
 	{
 		ObjshareProtocol_Send(process->slot,
-							  OBJSHARE_PROTOCOL_PDUTYPE_POLL_REQ,
+							  OBJSHARE_PROTOCOL_PDUTYPE_POLL_REQ, request->sequence,
 							  0, 0, 0);
 	}
 	break;
+
+	case PROCESS_CODE_READ_MULTI_REQ:
+	{
+		ObjshareHost_ReadEntry_t *entries = (ObjshareHost_ReadEntry_t *)process->data;
+
+		for (uint8_t i = 0; i < process->dataLength; i++)
+		{
+			MultiIds[i] = entries[i].objId;
+		}
+
+		ObjshareProtocol_Send(process->slot,
+							  OBJSHARE_PROTOCOL_PDUTYPE_READ_MULTI_REQ, request->sequence,
+							  0, MultiIds, process->dataLength);
+	}
+	break;
+
+	case PROCESS_CODE_WRITE_MULTI_REQ:
+	{
+		ObjshareProtocol_Send(process->slot,
+							  OBJSHARE_PROTOCOL_PDUTYPE_WRITE_MULTI_REQ, request->sequence,
+							  (uint8_t)process->dataLength, MultiBuffer, gatherMulti(process));
+	}
+	break;
+
+	case PROCESS_CODE_BROADCAST_WRITE_REQ:
+	{
+		ObjshareProtocol_Send(process->slot,
+							  OBJSHARE_PROTOCOL_PDUTYPE_WRITE_BROADCAST_REQ, request->sequence,
+							  process->objId,
+							  process->data, process->dataLength);
+	}
+	break;
+
+	case PROCESS_CODE_SUBSCRIBE_REQ:
+	{
+		ObjshareHost_Subscription_t *subscription = (ObjshareHost_Subscription_t *)process->data;
+		uint16_t length = 0;
+
+		// Peripheral is told the slot it is subscribed on; it comes back with the notifications.
+		if (subscription)
+		{
+			MultiBuffer[length++] = process->slot;
+			MultiBuffer[length++] = (uint8_t)subscription->minInterval;
+			MultiBuffer[length++] = (uint8_t)(subscription->minInterval >> 8);
+			memcpy(&MultiBuffer[length], &subscription->deadband, sizeof(subscription->deadband));
+			length += sizeof(subscription->deadband);
+		}
+
+		ObjshareProtocol_Send(process->slot,
+							  OBJSHARE_PROTOCOL_PDUTYPE_SUBSCRIBE_REQ, request->sequence,
+							  process->objId, MultiBuffer, length);
+	}
+	break;
+
+	case PROCESS_CODE_READ_RANGE_REQ:
+	{
+		// Range fits into the frame header along with the type, sequence and object id; it is
+		//copied there.
+		uint8_t range[OBJSHARE_PROTOCOL_READ_RANGE_PARAMETERS_SIZE] = {
+			(uint8_t)process->offset, (uint8_t)(process->offset >> 8),
+			(uint8_t)process->dataLength, (uint8_t)(process->dataLength >> 8)};
+
+		ObjshareProtocol_Send(process->slot,
+							  OBJSHARE_PROTOCOL_PDUTYPE_READ_RANGE_REQ, request->sequence,
+							  process->objId, range, sizeof(range));
+	}
+	break;
+
+	case PROCESS_CODE_WRITE_RANGE_REQ:
+	{
+		MultiBuffer[0] = (uint8_t)process->offset;
+		MultiBuffer[1] = (uint8_t)(process->offset >> 8);
+		memcpy(&MultiBuffer[OBJSHARE_PROTOCOL_RANGE_OFFSET_SIZE], process->data, process->dataLength);
+
+		ObjshareProtocol_Send(process->slot,
+							  OBJSHARE_PROTOCOL_PDUTYPE_WRITE_RANGE_REQ, request->sequence,
+							  process->objId, MultiBuffer,
+							  OBJSHARE_PROTOCOL_RANGE_OFFSET_SIZE + process->dataLength);
+	}
+	break;
+
+	case PROCESS_CODE_READ_DELTA_REQ:
+	{
+		ObjshareHost_CachedObject_t *object = (ObjshareHost_CachedObject_t *)process->data;
+
+		// Copied into the frame header, as the read range is. Every peripheral numbers its own
+		//baselines; a value cached from another slot is no baseline.
+		uint16_t number = (object->slot == process->slot) ? object->baseline : 0;
+		uint8_t baseline[OBJSHARE_PROTOCOL_DELTA_BASELINE_SIZE] = {(uint8_t)number, (uint8_t)(number >> 8)};
+
+		ObjshareProtocol_Send(process->slot,
+							  OBJSHARE_PROTOCOL_PDUTYPE_READ_DELTA_REQ, request->sequence,
+							  process->objId, baseline, sizeof(baseline));
+	}
+	break;
+
+	case PROCESS_CODE_READ_IF_CHANGED_REQ:
+	{
+		ObjshareHost_VersionedObject_t *object = (ObjshareHost_VersionedObject_t *)process->data;
+		uint8_t version[OBJSHARE_PROTOCOL_VERSION_SIZE] = {(uint8_t)object->version,
+														   (uint8_t)(object->version >> 8)};
+
+		ObjshareProtocol_Send(process->slot,
+							  OBJSHARE_PROTOCOL_PDUTYPE_READ_IF_CHANGED_REQ, request->sequence,
+							  process->objId, version, sizeof(version));
+	}
+	break;
+
+	case PROCESS_CODE_GET_CHANGES_REQ:
+	{
+		ObjshareHost_Changes_t *changes = (ObjshareHost_Changes_t *)process->data;
+		uint8_t sequence[OBJSHARE_PROTOCOL_JOURNAL_SEQUENCE_SIZE] = {(uint8_t)changes->sequence,
+																	 (uint8_t)(changes->sequence >> 8)};
+
+		ObjshareProtocol_Send(process->slot,
+							  OBJSHARE_PROTOCOL_PDUTYPE_GET_CHANGES_REQ, request->sequence,
+							  0, sequence, sizeof(sequence));
+	}
+	break;
 	}
 
-	LastRequestTimestamp = SysTime_GetTimeInMs();
-	WaitingResponse = TRUE;
+	request->timestamp = SysTime_GetTimeInMs();
+
+#ifdef OBJSHARE_HOST_LATENCY
+	// A retry is timed anew.
+	request->sentTimestamp = SysTime_GetTimeInUs();
+	request->isOut = FALSE;
+#endif
+}
+
+// Returns the request waiting for the response with the sequence number, 0 if there is none.
+static Request_t *getRequest(uint8_t sequence)
+{
+	for (uint8_t i = 0; i < OBJSHARE_HOST_MAX_WINDOW_SIZE; i++)
+	{
+		if (Window[i].isWaiting && (Window[i].sequence == sequence))
+		{
+			return &Window[i];
+		}
+	}
+
+	return 0;
+}
+
+static void releaseRequest(Request_t *request)
+{
+	request->isWaiting = FALSE;
+
+	// Slot is released once every request to it is answered.
+	if (!--WindowCount)
+	{
+		AddressSlotDelegate ? AddressSlotDelegate(0xFF) : (void)0;
+	}
+}
+
+// Requests which may take more than one fragment either way, and the requests sharing the
+//multi buffer, are not sent along with others. Read response is cut to the max length of the
+//read, so the max length tells whether it comes in fragments.
+static Bool_t isExclusive(Process_t *process)
+{
+	switch (process->code)
+	{
+	case PROCESS_CODE_READ_REQ:
+	case PROCESS_CODE_WRITE_REQ:
+	case PROCESS_CODE_READ_RANGE_REQ:
+		return (process->dataLength > OBJSHARE_PROTOCOL_MAX_FRAGMENT_SIZE) ? TRUE : FALSE;
+
+	case PROCESS_CODE_POLL_REQ:
+		return FALSE;
+
+	default:
+		return TRUE;
+	}
 }
 
 static void pduReceivedEventHandler(ObjshareProtocol_PduType_t pduType,
 									OperationResult_t operationResult,
 									uint16_t unparsedPduSize)
 {
-	if ((State != OBJSHARE_HOST_STATE_OPERATING) && !WaitingResponse)
+	// Notifications are not responses; they are delivered as they come, whatever is waiting.
+	if (pduType == OBJSHARE_PROTOCOL_PDUTYPE_NOTIFY)
+	{
+		uint8_t *data;
+		uint16_t length = ObjshareProtocol_ViewPduData(&data, unparsedPduSize);
+
+		if (length >= OBJSHARE_PROTOCOL_NOTIFY_HEADER_SIZE)
+		{
+			NotificationReceivedDelegate ? NotificationReceivedDelegate(data[0], data[1],
+																		&data[OBJSHARE_PROTOCOL_NOTIFY_HEADER_SIZE],
+																		length - OBJSHARE_PROTOCOL_NOTIFY_HEADER_SIZE)
+										 : (void)0;
+		}
+
+		return;
+	}
+
+	// Responses are matched to their requests by sequence number; others are dropped.
+	Request_t *request = getRequest(ObjshareProtocol_GetPduSequence());
+
+	if (!request)
 	{
 		return;
 	}
 
+	Process_t *cache = &request->process;
+
 	switch (pduType)
 	{
 	case OBJSHARE_PROTOCOL_PDUTYPE_READ_RESP:
+	case OBJSHARE_PROTOCOL_PDUTYPE_READ_RANGE_RESP:
 	{
-		if (Cache.code != PROCESS_CODE_READ_REQ)
+		if (cache->code != ((pduType == OBJSHARE_PROTOCOL_PDUTYPE_READ_RESP) ? PROCESS_CODE_READ_REQ
+																			  : PROCESS_CODE_READ_RANGE_REQ))
 		{
 			return;
 		}
@@ -414,39 +966,246 @@ static void pduReceivedEventHandler(ObjshareProtocol_PduType_t pduType,
 		// If success, call read response received delegate.
 		if (operationResult == OPERATION_RESULT_SUCCESS)
 		{
-			ObjshareProtocol_ParsePduData(Cache.data, Cache.dataLength, unparsedPduSize);
+			ObjshareProtocol_ParsePduData(cache->data, cache->dataLength, unparsedPduSize);
+
+			// Wait for the rest of the data; each fragment restarts the timeout.
+			if (!ObjshareProtocol_IsLastFragment())
+			{
+				request->timestamp = SysTime_GetTimeInMs();
+				return;
+			}
 
-			ReadResponseReceivedDelegate ? ReadResponseReceivedDelegate(Cache.slot, Cache.objId) : (void)0;
+			ReadResponseReceivedDelegate ? ReadResponseReceivedDelegate(cache->slot, cache->objId) : (void)0;
 		}
 		else
 		{
-			OperationFailedDelegate ? OperationFailedDelegate(Cache.slot) : (void)0;
+			OperationFailedDelegate ? OperationFailedDelegate(cache->slot) : (void)0;
 		}
 	}
 	break;
 
 	case OBJSHARE_PROTOCOL_PDUTYPE_WRITE_RESP:
+	case OBJSHARE_PROTOCOL_PDUTYPE_WRITE_RANGE_RESP:
+	{
+		if (cache->code != ((pduType == OBJSHARE_PROTOCOL_PDUTYPE_WRITE_RESP) ? PROCESS_CODE_WRITE_REQ
+																			   : PROCESS_CODE_WRITE_RANGE_REQ))
+		{
+			return;
+		}
+
+		if (operationResult == OPERATION_RESULT_FAILURE)
+		{
+			OperationFailedDelegate ? OperationFailedDelegate(cache->slot) : (void)0;
+		}
+	}
+	break;
+
+	case OBJSHARE_PROTOCOL_PDUTYPE_SUBSCRIBE_RESP:
 	{
-		if (Cache.code != PROCESS_CODE_WRITE_REQ)
+		if (cache->code != PROCESS_CODE_SUBSCRIBE_REQ)
 		{
 			return;
 		}
 
 		if (operationResult == OPERATION_RESULT_FAILURE)
 		{
-			OperationFailedDelegate ? OperationFailedDelegate(Cache.slot) : (void)0;
+			OperationFailedDelegate ? OperationFailedDelegate(cache->slot) : (void)0;
 		}
 	}
 	break;
 
 	case OBJSHARE_PROTOCOL_PDUTYPE_POLL_RESP:
 	{
-		if (Cache.code != PROCESS_CODE_POLL_REQ)
+		if (cache->code != PROCESS_CODE_POLL_REQ)
+		{
+			return;
+		}
+
+		PollResponseReceivedDelegate ? PollResponseReceivedDelegate(cache->slot) : (void)0;
+	}
+	break;
+
+	case OBJSHARE_PROTOCOL_PDUTYPE_READ_MULTI_RESP:
+	{
+		if (cache->code != PROCESS_CODE_READ_MULTI_REQ)
+		{
+			return;
+		}
+
+		if (operationResult == OPERATION_RESULT_SUCCESS)
+		{
+			// Response is collected as a whole, then scattered into the entries.
+			ObjshareProtocol_ParsePduData(MultiBuffer, sizeof(MultiBuffer), unparsedPduSize);
+
+			if (!ObjshareProtocol_IsLastFragment())
+			{
+				request->timestamp = SysTime_GetTimeInMs();
+				return;
+			}
+
+			scatterMulti(cache, ObjshareProtocol_GetPduDataOffset() + unparsedPduSize);
+
+			ReadMultiResponseReceivedDelegate ? ReadMultiResponseReceivedDelegate(cache->slot,
+																				  (ObjshareHost_ReadEntry_t *)cache->data,
+																				  (uint8_t)cache->dataLength)
+											  : (void)0;
+		}
+		else
+		{
+			OperationFailedDelegate ? OperationFailedDelegate(cache->slot) : (void)0;
+		}
+	}
+	break;
+
+	case OBJSHARE_PROTOCOL_PDUTYPE_READ_DELTA_RESP:
+	{
+		if (cache->code != PROCESS_CODE_READ_DELTA_REQ)
 		{
 			return;
 		}
 
-		PollResponseReceivedDelegate ? PollResponseReceivedDelegate(Cache.slot) : (void)0;
+		ObjshareHost_CachedObject_t *object = (ObjshareHost_CachedObject_t *)cache->data;
+
+		if (operationResult == OPERATION_RESULT_SUCCESS)
+		{
+			// Response is collected as a whole, then applied to the cached value.
+			ObjshareProtocol_ParsePduData(MultiBuffer, sizeof(MultiBuffer), unparsedPduSize);
+
+			if (!ObjshareProtocol_IsLastFragment())
+			{
+				request->timestamp = SysTime_GetTimeInMs();
+				return;
+			}
+
+			operationResult = applyDelta(object, cache->slot, ObjshareProtocol_GetPduDataOffset() + unparsedPduSize)
+								  ? OPERATION_RESULT_SUCCESS
+								  : OPERATION_RESULT_FAILURE;
+		}
+
+		if (operationResult == OPERATION_RESULT_SUCCESS)
+		{
+			ReadResponseReceivedDelegate ? ReadResponseReceivedDelegate(cache->slot, cache->objId) : (void)0;
+		}
+		else
+		{
+			object->baseline = 0;
+			OperationFailedDelegate ? OperationFailedDelegate(cache->slot) : (void)0;
+		}
+	}
+	break;
+
+	case OBJSHARE_PROTOCOL_PDUTYPE_READ_IF_CHANGED_RESP:
+	{
+		if (cache->code != PROCESS_CODE_READ_IF_CHANGED_REQ)
+		{
+			return;
+		}
+
+		ObjshareHost_VersionedObject_t *object = (ObjshareHost_VersionedObject_t *)cache->data;
+
+		if (operationResult == OPERATION_RESULT_SUCCESS)
+		{
+			// Response is collected as a whole, then copied into the object.
+			ObjshareProtocol_ParsePduData(MultiBuffer, sizeof(MultiBuffer), unparsedPduSize);
+
+			if (!ObjshareProtocol_IsLastFragment())
+			{
+				request->timestamp = SysTime_GetTimeInMs();
+				return;
+			}
+
+			uint16_t length = ObjshareProtocol_GetPduDataOffset() + unparsedPduSize;
+
+			if ((length < OBJSHARE_PROTOCOL_VERSION_SIZE) || (length > sizeof(MultiBuffer)))
+			{
+				OperationFailedDelegate ? OperationFailedDelegate(cache->slot) : (void)0;
+				break;
+			}
+
+			length -= OBJSHARE_PROTOCOL_VERSION_SIZE;
+			memcpy(object->data, &MultiBuffer[OBJSHARE_PROTOCOL_VERSION_SIZE],
+				   (length < object->maxLength) ? length : object->maxLength);
+
+			object->version = (uint16_t)MultiBuffer[0] | ((uint16_t)MultiBuffer[1] << 8);
+			object->isModified = TRUE;
+		}
+		else if (operationResult == OBJSHARE_PROTOCOL_OPERATION_RESULT_NOT_MODIFIED)
+		{
+			object->isModified = FALSE;
+		}
+		else
+		{
+			OperationFailedDelegate ? OperationFailedDelegate(cache->slot) : (void)0;
+			break;
+		}
+
+		ReadResponseReceivedDelegate ? ReadResponseReceivedDelegate(cache->slot, cache->objId) : (void)0;
+	}
+	break;
+
+	case OBJSHARE_PROTOCOL_PDUTYPE_GET_CHANGES_RESP:
+	{
+		if (cache->code != PROCESS_CODE_GET_CHANGES_REQ)
+		{
+			return;
+		}
+
+		ObjshareHost_Changes_t *changes = (ObjshareHost_Changes_t *)cache->data;
+
+		if (operationResult != OPERATION_RESULT_SUCCESS)
+		{
+			OperationFailedDelegate ? OperationFailedDelegate(cache->slot) : (void)0;
+			break;
+		}
+
+		ObjshareProtocol_ParsePduData(MultiBuffer, sizeof(MultiBuffer), unparsedPduSize);
+
+		if (!ObjshareProtocol_IsLastFragment())
+		{
+			request->timestamp = SysTime_GetTimeInMs();
+			return;
+		}
+
+		uint16_t length = ObjshareProtocol_GetPduDataOffset() + unparsedPduSize;
+
+		if ((length < OBJSHARE_PROTOCOL_JOURNAL_SEQUENCE_SIZE) ||
+			(length > (OBJSHARE_PROTOCOL_JOURNAL_SEQUENCE_SIZE + OBJSHARE_PROTOCOL_MAX_CHANGE_COUNT)))
+		{
+			OperationFailedDelegate ? OperationFailedDelegate(cache->slot) : (void)0;
+			break;
+		}
+
+		changes->sequence = (uint16_t)MultiBuffer[0] | ((uint16_t)MultiBuffer[1] << 8);
+		changes->count = (uint8_t)(length - OBJSHARE_PROTOCOL_JOURNAL_SEQUENCE_SIZE);
+		memcpy(changes->objIds, &MultiBuffer[OBJSHARE_PROTOCOL_JOURNAL_SEQUENCE_SIZE], changes->count);
+
+		ChangesReceivedDelegate ? ChangesReceivedDelegate(cache->slot, changes) : (void)0;
+	}
+	break;
+
+	case OBJSHARE_PROTOCOL_PDUTYPE_WRITE_MULTI_RESP:
+	{
+		if (cache->code != PROCESS_CODE_WRITE_MULTI_REQ)
+		{
+			return;
+		}
+
+		if (operationResult == OPERATION_RESULT_SUCCESS)
+		{
+			uint8_t results[OBJSHARE_PROTOCOL_MULTI_BITMAP_SIZE] = {0};
+
+			ObjshareProtocol_ParsePduData(results, sizeof(results), unparsedPduSize);
+			setMultiResults(cache, results);
+
+			WriteMultiResponseReceivedDelegate ? WriteMultiResponseReceivedDelegate(cache->slot,
+																					(ObjshareHost_WriteEntry_t *)cache->data,
+																					(uint8_t)cache->dataLength)
+											   : (void)0;
+		}
+		else
+		{
+			OperationFailedDelegate ? OperationFailedDelegate(cache->slot) : (void)0;
+		}
 	}
 	break;
 
@@ -454,6 +1213,255 @@ static void pduReceivedEventHandler(ObjshareProtocol_PduType_t pduType,
 		break;
 	}
 
-	AddressSlotDelegate ? AddressSlotDelegate(0xFF) : (void)0;
-	WaitingResponse = FALSE;
-}
\ No newline at end of file
+#ifdef OBJSHARE_HOST_LATENCY
+	uint32_t sys_time = SysTime_GetTimeInUs();
+
+	// Transmission may be reported complete after the response is decoded; no turnaround then.
+	if (!request->isOut)
+	{
+		request->outTimestamp = sys_time;
+		request->isOut = TRUE;
+
+		recordLatency(OBJSHARE_HOST_LATENCY_WIRE, cache, request->outTimestamp - request->sentTimestamp);
+	}
+
+	recordLatency(OBJSHARE_HOST_LATENCY_TURNAROUND, cache, sys_time - request->outTimestamp);
+#endif
+
+	TRACE(TRACE_EVENT_REQUEST_RESPONSE, cache->slot, ((uint16_t)pduType << 8) | operationResult);
+
+	releaseRequest(request);
+}
+
+static void switchDirectionEventHandler(ObjshareProtocol_Direction_t direction)
+{
+#ifdef OBJSHARE_HOST_LATENCY
+	// Line is turned around once the last byte of the requests is out.
+	for (uint8_t i = 0; (direction == OBJSHARE_PROTOCOL_DIRECTION_RX) && (i < OBJSHARE_HOST_MAX_WINDOW_SIZE); i++)
+	{
+		Request_t *request = &Window[i];
+
+		if (request->isWaiting && !request->isOut)
+		{
+			request->outTimestamp = SysTime_GetTimeInUs();
+			request->isOut = TRUE;
+
+			recordLatency(OBJSHARE_HOST_LATENCY_WIRE, &request->process,
+						  request->outTimestamp - request->sentTimestamp);
+		}
+	}
+#endif
+
+	// Broadcast is done once it is out; it is sent alone, and nothing answers it.
+	if ((direction == OBJSHARE_PROTOCOL_DIRECTION_RX) && WindowExclusive && WindowCount &&
+		(WindowSlot == OBJSHARE_HOST_BROADCAST_SLOT))
+	{
+		for (uint8_t i = 0; i < OBJSHARE_HOST_MAX_WINDOW_SIZE; i++)
+		{
+			if (Window[i].isWaiting)
+			{
+				TRACE(TRACE_EVENT_REQUEST_RESPONSE, OBJSHARE_HOST_BROADCAST_SLOT,
+					  (uint16_t)OBJSHARE_PROTOCOL_PDUTYPE_WRITE_BROADCAST_REQ << 8);
+				releaseRequest(&Window[i]);
+			}
+		}
+	}
+
+	SwitchDirectionDelegate ? SwitchDirectionDelegate(direction) : (void)0;
+}
+
+// Copies the data of each object read out of the received response; entries whose data is
+//missing from it fail.
+static void scatterMulti(Process_t *process, uint16_t length)
+{
+	ObjshareHost_ReadEntry_t *entries = (ObjshareHost_ReadEntry_t *)process->data;
+	uint16_t data_idx = process->dataLength * OBJSHARE_PROTOCOL_MULTI_RESULT_SIZE;
+
+	length = (length < sizeof(MultiBuffer)) ? length : sizeof(MultiBuffer);
+
+	for (uint8_t i = 0; i < process->dataLength; i++)
+	{
+		uint8_t *result = &MultiBuffer[i * OBJSHARE_PROTOCOL_MULTI_RESULT_SIZE];
+		uint16_t data_length = (uint16_t)result[1] | ((uint16_t)result[2] << 8);
+
+		entries[i].result = OPERATION_RESULT_FAILURE;
+
+		if ((data_idx > length) || (result[0] != OPERATION_RESULT_SUCCESS) ||
+			(data_length > (length - data_idx)))
+		{
+			continue;
+		}
+
+		memcpy(entries[i].data, &MultiBuffer[data_idx],
+			   (data_length < entries[i].maxLength) ? data_length : entries[i].maxLength);
+		data_idx += data_length;
+
+		entries[i].result = OPERATION_RESULT_SUCCESS;
+	}
+}
+
+// Puts the header and data of each object to be written one after another into the buffer;
+//returns the length of the request.
+static uint16_t gatherMulti(Process_t *process)
+{
+	ObjshareHost_WriteEntry_t *entries = (ObjshareHost_WriteEntry_t *)process->data;
+	uint16_t length = 0;
+
+	for (uint8_t i = 0; i < process->dataLength; i++)
+	{
+		MultiBuffer[length++] = entries[i].objId;
+		MultiBuffer[length++] = (uint8_t)entries[i].dataLength;
+		MultiBuffer[length++] = (uint8_t)(entries[i].dataLength >> 8);
+
+		memcpy(&MultiBuffer[length], entries[i].data, entries[i].dataLength);
+		length += entries[i].dataLength;
+	}
+
+	return length;
+}
+
+static void setMultiResults(Process_t *process, uint8_t *results)
+{
+	ObjshareHost_WriteEntry_t *entries = (ObjshareHost_WriteEntry_t *)process->data;
+
+	for (uint8_t i = 0; i < process->dataLength; i++)
+	{
+		entries[i].result = (results[i >> 3] & (1U << (i & 0x07))) ? OPERATION_RESULT_SUCCESS
+																	: OPERATION_RESULT_FAILURE;
+	}
+}
+
+// Applies the read delta response of the slot in the multi buffer to the cached value, and takes
+//the number of the value received as the baseline of the next delta. A whole value has to be the
+//length of the object.
+static Bool_t applyDelta(ObjshareHost_CachedObject_t *object, uint8_t slot, uint16_t length)
+{
+	if ((length < OBJSHARE_PROTOCOL_DELTA_HEADER_SIZE) || (length > sizeof(MultiBuffer)))
+	{
+		return FALSE;
+	}
+
+	uint8_t *payload = &MultiBuffer[OBJSHARE_PROTOCOL_DELTA_HEADER_SIZE];
+	uint16_t payload_length = length - OBJSHARE_PROTOCOL_DELTA_HEADER_SIZE;
+
+	switch (MultiBuffer[0])
+	{
+	case OBJSHARE_PROTOCOL_DELTA_ENCODING_FULL:
+	{
+		if (payload_length != object->length)
+		{
+			return FALSE;
+		}
+
+		memcpy(object->data, payload, payload_length);
+	}
+	break;
+
+	case OBJSHARE_PROTOCOL_DELTA_ENCODING_XOR_RLE:
+	{
+		if (!decodeDelta(object->data, object->length, payload, payload_length))
+		{
+			return FALSE;
+		}
+	}
+	break;
+
+	default:
+		return FALSE;
+	}
+
+	object->baseline = (uint16_t)MultiBuffer[1] | ((uint16_t)MultiBuffer[2] << 8);
+	object->slot = slot;
+
+	return TRUE;
+}
+
+// Xor's the changed bytes of each token onto the value; fails on a token running past the
+//value or the delta.
+static Bool_t decodeDelta(uint8_t *value, uint16_t length, uint8_t *delta, uint16_t deltaLength)
+{
+	uint32_t idx = 0;
+	uint16_t delta_idx = 0;
+
+	while (delta_idx < deltaLength)
+	{
+		if ((deltaLength - delta_idx) < OBJSHARE_PROTOCOL_DELTA_TOKEN_SIZE)
+		{
+			return FALSE;
+		}
+
+		uint8_t changed_count;
+
+		idx += delta[delta_idx++];
+		changed_count = delta[delta_idx++];
+
+		if (((idx + changed_count) > length) || (changed_count > (deltaLength - delta_idx)))
+		{
+			return FALSE;
+		}
+
+		for (; changed_count; changed_count--)
+		{
+			value[idx++] ^= delta[delta_idx++];
+		}
+	}
+
+	return TRUE;
+}
+
+#ifdef OBJSHARE_HOST_LATENCY
+static void recordLatency(ObjshareHost_LatencyPhase_t phase, Process_t *process, uint32_t latency)
+{
+	addLatencySample(&Latency.byRequest[phase][process->code], latency);
+
+	if (process->slot < OBJSHARE_HOST_LATENCY_SLOT_COUNT)
+	{
+		addLatencySample(&Latency.bySlot[phase][process->slot], latency);
+	}
+}
+
+static void addLatencySample(ObjshareHost_LatencyHistogram_t *histogram, uint32_t latency)
+{
+	histogram->min = (!histogram->count || (latency < histogram->min)) ? latency : histogram->min;
+	histogram->max = (latency > histogram->max) ? latency : histogram->max;
+	histogram->sum += latency;
+	histogram->count++;
+	histogram->buckets[getLatencyBucket(latency)]++;
+}
+
+// Values below 1 << SUB_BUCKET_BITS have a bucket each; above, every power of two is split
+//into 1 << SUB_BUCKET_BITS buckets by the bits following the leading one.
+static uint8_t getLatencyBucket(uint32_t latency)
+{
+	if (latency < (1U << OBJSHARE_HOST_LATENCY_SUB_BUCKET_BITS))
+	{
+		return (uint8_t)latency;
+	}
+
+	uint8_t exponent = 31 - __builtin_clz(latency);
+
+	if (exponent > OBJSHARE_HOST_LATENCY_MAX_EXPONENT)
+	{
+		return OBJSHARE_HOST_LATENCY_BUCKET_COUNT - 1;
+	}
+
+	return ((exponent - OBJSHARE_HOST_LATENCY_SUB_BUCKET_BITS + 1) << OBJSHARE_HOST_LATENCY_SUB_BUCKET_BITS) +
+		   ((latency >> (exponent - OBJSHARE_HOST_LATENCY_SUB_BUCKET_BITS)) &
+			((1U << OBJSHARE_HOST_LATENCY_SUB_BUCKET_BITS) - 1));
+}
+
+// Returns the lowest latency falling into the bucket.
+static uint32_t getLatencyBucketValue(uint8_t bucket)
+{
+	if (bucket < (1U << OBJSHARE_HOST_LATENCY_SUB_BUCKET_BITS))
+	{
+		return bucket;
+	}
+
+	uint8_t exponent = (bucket >> OBJSHARE_HOST_LATENCY_SUB_BUCKET_BITS) + OBJSHARE_HOST_LATENCY_SUB_BUCKET_BITS - 1;
+
+	return (uint32_t)((1U << OBJSHARE_HOST_LATENCY_SUB_BUCKET_BITS) |
+					  (bucket & ((1U << OBJSHARE_HOST_LATENCY_SUB_BUCKET_BITS) - 1)))
+		   << (exponent - OBJSHARE_HOST_LATENCY_SUB_BUCKET_BITS);
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,349 @@
+#ifndef __OBJSHARE_HOST_H
+#define __OBJSHARE_HOST_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "generic.h"
+#include "queue_generic.h"
+#include "objshare_protocol.h"
+
+/* Exported definitions ----------------------------------------------------*/
+#define OBJSHARE_HOST_TIMEOUT_IN_MS 50
+#define OBJSHARE_HOST_MAX_SUCCESSIVE_REQUESTS 3
+
+// Requests sent to a slot before the responses of the previous ones are received. The window is
+//set with ObjshareHost_SetWindowSize and is 1 by default, which is stop-and-wait; larger windows
+//need a link the peripheral can receive on while transmitting, and should not exceed the
+//peripheral's PACKET_MANAGER_TX_QUEUE_LENGTH.
+#define OBJSHARE_HOST_MAX_WINDOW_SIZE 4
+
+// Slot given to the address slot delegate for a broadcast; every slot has to be addressed.
+#define OBJSHARE_HOST_BROADCAST_SLOT 0xFE
+
+// Latency histograms of the requests, read with ObjshareHost_GetLatency; compiled out unless
+//defined. Buckets are log-linear, 1 << SUB_BUCKET_BITS of them per power of two microseconds,
+//and the last one also takes everything from 1 << (MAX_EXPONENT + 1) on.
+//#define OBJSHARE_HOST_LATENCY
+#define OBJSHARE_HOST_LATENCY_SUB_BUCKET_BITS 2
+#define OBJSHARE_HOST_LATENCY_MAX_EXPONENT 19
+#define OBJSHARE_HOST_LATENCY_BUCKET_COUNT \
+	((OBJSHARE_HOST_LATENCY_MAX_EXPONENT - OBJSHARE_HOST_LATENCY_SUB_BUCKET_BITS + 2) << OBJSHARE_HOST_LATENCY_SUB_BUCKET_BITS)
+
+// Slots from this on are left out of the per slot histograms.
+#ifndef OBJSHARE_HOST_LATENCY_SLOT_COUNT
+#define OBJSHARE_HOST_LATENCY_SLOT_COUNT 4
+#endif
+
+	/* Exported types ------------------------------------------------------------*/
+	enum
+	{
+		OBJSHARE_HOST_STATE_UNINIT = 0x00,
+		OBJSHARE_HOST_STATE_READY,
+		OBJSHARE_HOST_STATE_OPERATING
+	};
+	typedef uint8_t ObjshareHost_State_t;
+
+	// Requests in process code order.
+	enum
+	{
+		OBJSHARE_HOST_REQUEST_READ = 0x00,
+		OBJSHARE_HOST_REQUEST_WRITE,
+		OBJSHARE_HOST_REQUEST_POLL,
+		OBJSHARE_HOST_REQUEST_READ_MULTI,
+		OBJSHARE_HOST_REQUEST_WRITE_MULTI,
+		OBJSHARE_HOST_REQUEST_BROADCAST_WRITE,
+		OBJSHARE_HOST_REQUEST_SUBSCRIBE,
+		OBJSHARE_HOST_REQUEST_READ_RANGE,
+		OBJSHARE_HOST_REQUEST_WRITE_RANGE,
+		OBJSHARE_HOST_REQUEST_READ_DELTA,
+		OBJSHARE_HOST_REQUEST_READ_IF_CHANGED,
+		OBJSHARE_HOST_REQUEST_GET_CHANGES,
+		OBJSHARE_HOST_REQUEST_COUNT
+	};
+	typedef uint8_t ObjshareHost_Request_t;
+
+	// Queue wait is from the request call until it is sent, wire until its last byte is out
+	//and turnaround until the response is received completely.
+	enum
+	{
+		OBJSHARE_HOST_LATENCY_QUEUE = 0x00,
+		OBJSHARE_HOST_LATENCY_WIRE,
+		OBJSHARE_HOST_LATENCY_TURNAROUND,
+		OBJSHARE_HOST_LATENCY_PHASE_COUNT
+	};
+	typedef uint8_t ObjshareHost_LatencyPhase_t;
+
+	// Samples in microseconds.
+	typedef struct
+	{
+		uint32_t count;
+		uint32_t min;
+		uint32_t max;
+		uint64_t sum;
+		uint32_t buckets[OBJSHARE_HOST_LATENCY_BUCKET_COUNT];
+	} ObjshareHost_LatencyHistogram_t;
+
+	typedef struct
+	{
+		ObjshareHost_LatencyHistogram_t byRequest[OBJSHARE_HOST_LATENCY_PHASE_COUNT][OBJSHARE_HOST_REQUEST_COUNT];
+		ObjshareHost_LatencyHistogram_t bySlot[OBJSHARE_HOST_LATENCY_PHASE_COUNT][OBJSHARE_HOST_LATENCY_SLOT_COUNT];
+	} ObjshareHost_Latency_t;
+
+	// Object of a read multi request; data is copied into the buffer, up to its max length,
+	//and the result is set when the response is received.
+	typedef struct
+	{
+		uint8_t objId;
+		uint8_t *data;
+		uint16_t maxLength;
+		OperationResult_t result;
+	} ObjshareHost_ReadEntry_t;
+
+	// Object of a write multi request; the result is set when the response is received.
+	typedef struct
+	{
+		uint8_t objId;
+		uint8_t *data;
+		uint16_t dataLength;
+		OperationResult_t result;
+	} ObjshareHost_WriteEntry_t;
+
+	// Object to be notified of by the slot; a change of a float object is notified once it is at
+	//least the deadband, that of another object always. Notifications are at least the minimum
+	//interval, in ms, apart.
+	typedef struct
+	{
+		uint8_t objId;
+		uint16_t minInterval;
+		float deadband;
+	} ObjshareHost_Subscription_t;
+
+	// Object read in deltas against the value cached in data, which is the length of the object.
+	//Baseline is the number the peripheral gave the cached value; 0 until a value is received,
+	//and set back to 0 to have the whole value sent again. Baseline numbers are those of the slot
+	//the value came from; reading the object from another slot gets the whole value.
+	typedef struct
+	{
+		uint8_t objId;
+		uint8_t *data;
+		uint16_t length;
+		uint16_t baseline;
+		uint8_t slot;
+	} ObjshareHost_CachedObject_t;
+
+	// Object read only when its version differs from the one last read into data, up to its max
+	//length. Version is 0 until the object is read; is modified tells whether the last response
+	//brought the object.
+	typedef struct
+	{
+		uint8_t objId;
+		uint8_t *data;
+		uint16_t maxLength;
+		uint16_t version;
+		Bool_t isModified;
+	} ObjshareHost_VersionedObject_t;
+
+	// Objects of a slot changed since the journal sequence. Sequence is 0 until the first
+	//response, which lists every object; each response sets it to the one to ask from next.
+	typedef struct
+	{
+		uint16_t sequence;
+		uint8_t count;
+		uint8_t objIds[OBJSHARE_PROTOCOL_MAX_CHANGE_COUNT];
+	} ObjshareHost_Changes_t;
+
+	// Delegates.
+	typedef void (*ObjshareHost_ReadResponseReceivedDelegate_t)(uint8_t slot, uint8_t objId);
+	typedef void (*ObjshareHost_ReadMultiResponseReceivedDelegate_t)(uint8_t slot,
+																	 ObjshareHost_ReadEntry_t *entries,
+																	 uint8_t count);
+	typedef void (*ObjshareHost_WriteMultiResponseReceivedDelegate_t)(uint8_t slot,
+																	  ObjshareHost_WriteEntry_t *entries,
+																	  uint8_t count);
+	typedef void (*ObjshareHost_OperationFailedDelegate_t)(uint8_t slot);
+	typedef void (*ObjshareHost_NoResponseDelegate_t)(uint8_t slot);
+	typedef void (*ObjshareHost_PollResponseDelegate_t)(uint8_t slot);
+	typedef void (*ObjshareHost_AddressSlotDelegate_t)(uint8_t slot);
+	// Data is valid until the delegate returns.
+	typedef void (*ObjshareHost_NotificationReceivedDelegate_t)(uint8_t slot, uint8_t objId,
+																uint8_t *data, uint16_t dataLength);
+	typedef void (*ObjshareHost_ChangesReceivedDelegate_t)(uint8_t slot, ObjshareHost_Changes_t *changes);
+
+	typedef struct
+	{
+		ObjshareHost_AddressSlotDelegate_t addressSlotDelegate;
+		ObjshareProtocol_SwitchDirectionDelegate_t switchDirectionDelegate;
+		ObjshareHost_ReadResponseReceivedDelegate_t readResponseReceivedDelegate;
+		ObjshareHost_NoResponseDelegate_t noResponseDelegate;
+		ObjshareHost_OperationFailedDelegate_t operationFailedDelegate;
+		ObjshareHost_PollResponseDelegate_t pollResponseReceivedDelegate;
+		ObjshareHost_ReadMultiResponseReceivedDelegate_t readMultiResponseReceivedDelegate;
+		ObjshareHost_WriteMultiResponseReceivedDelegate_t writeMultiResponseReceivedDelegate;
+		ObjshareHost_NotificationReceivedDelegate_t notificationReceivedDelegate;
+		ObjshareHost_ChangesReceivedDelegate_t changesReceivedDelegate;
+	} ObjshareHost_Delegates_t;
+
+	/* Exported functions --------------------------------------------------------*/
+#ifdef OBJSHARE_HOST_TEST
+	extern void ObjshareHost_Test(ObjshareHost_AddressSlotDelegate_t addressSlotEventHandler,
+								  ObjshareProtocol_SwitchDirectionDelegate_t switchDirectionEventHandler);
+#endif
+
+	// Functions controlling module behaviour.
+	extern void ObjshareHost_Setup(ObjshareHost_Delegates_t *delegates);
+	extern Bool_t ObjshareHost_Start(void);
+	extern void ObjshareHost_Execute(void);
+	extern void ObjshareHost_ClearPending(void);
+	extern void ObjshareHost_Stop(void);
+	extern ObjshareHost_State_t ObjshareHost_GetState(void);
+
+	/***
+	 * @Brief      Sets the number of requests waiting for their responses at once.
+	 *
+	 * @Params     size-> Window size; limited to 1 - OBJSHARE_HOST_MAX_WINDOW_SIZE.
+	 */
+	extern void ObjshareHost_SetWindowSize(uint8_t size);
+
+	// Functions to request operations from the peripherals.
+	extern void ObjshareHost_SendReadRequest(uint8_t slot, uint8_t objId, uint8_t *data,
+											 uint16_t maxLength);
+	extern void ObjshareHost_SendWriteRequest(uint8_t slot, uint8_t objId, uint8_t *data,
+											  uint16_t dataLength);
+	extern void ObjshareHost_SendPollRequest(uint8_t slot);
+
+	/***
+	 * @Brief      Reads part of an object, such as an element of a table; the read response
+	 *             received delegate is called with the object id. Ranges not within the object
+	 *             fail.
+	 *
+	 * @Params     slot-> Slot of the peripheral.
+	 *             objId-> Object to be read.
+	 *             offset-> Offset of the range within the object.
+	 *             data-> Buffer the range is copied into.
+	 *             length-> Length of the range.
+	 */
+	extern void ObjshareHost_SendReadRangeRequest(uint8_t slot, uint8_t objId, uint16_t offset,
+												  uint8_t *data, uint16_t length);
+
+	/***
+	 * @Brief      Writes part of an object; the rest of it is left as it is. Ranges not within the
+	 *             object fail, and nothing is written.
+	 *
+	 * @Params     slot-> Slot of the peripheral.
+	 *             objId-> Object to be written.
+	 *             offset-> Offset of the range within the object.
+	 *             data-> Data of the range; has to stay valid until the response.
+	 *             length-> Length of the range; requests with more than
+	 *             OBJSHARE_PROTOCOL_MAX_MULTI_DATA_SIZE - OBJSHARE_PROTOCOL_RANGE_OFFSET_SIZE
+	 *             bytes are discarded.
+	 */
+	extern void ObjshareHost_SendWriteRangeRequest(uint8_t slot, uint8_t objId, uint16_t offset,
+												   uint8_t *data, uint16_t length);
+
+	/***
+	 * @Brief      Reads an object into its cached value; the peripheral sends only the bytes
+	 *             changed since the value it sent last, when the cache holds that. Whole value is
+	 *             sent for the first read, for a read from another slot than the cached value's,
+	 *             and for a retry after a timeout. Read response received delegate is called with
+	 *             the object id.
+	 *
+	 * @Params     slot-> Slot of the peripheral.
+	 *             object-> Cached object; has to stay valid until the response. Objects larger
+	 *             than OBJSHARE_PROTOCOL_MAX_MULTI_DATA_SIZE - OBJSHARE_PROTOCOL_DELTA_HEADER_SIZE
+	 *             fail.
+	 */
+	extern void ObjshareHost_SendReadDeltaRequest(uint8_t slot, ObjshareHost_CachedObject_t *object);
+
+	/***
+	 * @Brief      Reads an object if its version has changed since it was last read; otherwise
+	 *             the peripheral answers with a single byte. Read response received delegate is
+	 *             called with the object id either way.
+	 *
+	 * @Params     slot-> Slot of the peripheral.
+	 *             object-> Versioned object; has to stay valid until the response. Objects larger
+	 *             than OBJSHARE_PROTOCOL_MAX_MULTI_DATA_SIZE - OBJSHARE_PROTOCOL_VERSION_SIZE fail.
+	 */
+	extern void ObjshareHost_SendReadIfChangedRequest(uint8_t slot, ObjshareHost_VersionedObject_t *object);
+
+	/***
+	 * @Brief      Gets the ids of the objects changed since the sequence of the changes, so that
+	 *             only those are read. Every object is listed for sequence 0, or when the
+	 *             peripheral journal does not go back that far. Changes received delegate is called
+	 *             with the changes.
+	 *
+	 * @Params     slot-> Slot of the peripheral.
+	 *             changes-> Changes; has to stay valid until the response.
+	 */
+	extern void ObjshareHost_SendGetChangesRequest(uint8_t slot, ObjshareHost_Changes_t *changes);
+
+	/***
+	 * @Brief      Reads several objects of the slot in one round trip.
+	 *
+	 * @Params     slot-> Slot of the peripheral.
+	 *             entries-> Objects to be read; have to stay valid until the response.
+	 *             count-> Number of entries, OBJSHARE_PROTOCOL_MAX_MULTI_COUNT at most;
+	 *             requests with more are discarded.
+	 */
+	extern void ObjshareHost_SendReadMultiRequest(uint8_t slot, ObjshareHost_ReadEntry_t *entries,
+												  uint8_t count);
+
+	/***
+	 * @Brief      Writes several objects of the slot in one round trip.
+	 *
+	 * @Params     slot-> Slot of the peripheral.
+	 *             entries-> Objects to be written; have to stay valid until the response.
+	 *             count-> Number of entries, OBJSHARE_PROTOCOL_MAX_MULTI_COUNT at most; requests
+	 *             with more, or with more than OBJSHARE_PROTOCOL_MAX_MULTI_DATA_SIZE bytes of
+	 *             objects and their headers, are discarded.
+	 */
+	extern void ObjshareHost_SendWriteMultiRequest(uint8_t slot, ObjshareHost_WriteEntry_t *entries,
+												   uint8_t count);
+
+	/***
+	 * @Brief      Writes the object on every slot at once. Peripherals apply the write without
+	 *             responding; it is done once sent, and can be confirmed by reading the object
+	 *             back from the slots.
+	 *
+	 * @Params     objId-> Object to be written.
+	 *             data-> Data to be written; has to stay valid until the write is sent.
+	 *             dataLength-> Length of the data.
+	 */
+	extern void ObjshareHost_SendBroadcastWriteRequest(uint8_t objId, uint8_t *data, uint16_t dataLength);
+
+	/***
+	 * @Brief      Subscribes to an object of the slot; its changes are given to the notification
+	 *             received delegate as the peripheral sends them, without being requested.
+	 *             Subscribing again to the object updates the subscription.
+	 *
+	 * @Params     slot-> Slot of the peripheral.
+	 *             subscription-> Object and its notification limits; has to stay valid until the
+	 *             response.
+	 */
+	extern void ObjshareHost_SendSubscribeRequest(uint8_t slot, ObjshareHost_Subscription_t *subscription);
+	extern void ObjshareHost_SendUnsubscribeRequest(uint8_t slot, uint8_t objId);
+
+#ifdef OBJSHARE_HOST_LATENCY
+	// Functions to read the latency histograms.
+	extern void ObjshareHost_GetLatency(ObjshareHost_Latency_t *latency);
+	extern void ObjshareHost_ResetLatency(void);
+
+	/***
+	 * @Brief      Estimates a percentile from the histogram.
+	 *
+	 * @Params     histogram-> Histogram from the latency snapshot.
+	 *             percent-> Percentile; 50 for the median.
+	 *
+	 * @Return     Highest latency of the bucket the percentile falls into, in microseconds.
+	 */
+	extern uint32_t ObjshareHost_GetLatencyPercentile(const ObjshareHost_LatencyHistogram_t *histogram,
+													  uint8_t percent);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,196 @@
+/***
+  * @author     Onur Efe
+  */
+#ifndef __OBJSHARE_PROTOCOL_H
+#define __OBJSHARE_PROTOCOL_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Include files -------------------------------------------------------------*/
+#include "generic.h"
+
+/* Exported constants --------------------------------------------------------*/
+#define OBJSHARE_PROTOCOL_HOST
+//#define OBJSHARE_PROTOCOL_PERIPHERAL
+
+// Every pdu starts with its type and a sequence number; the host numbers its requests and the
+//peripheral echoes the number of the request in the response.
+//Data longer than a fragment is sent in fragment pdus; the pdu type is flagged and the object id
+//or operation result is followed by the fragment's sequence number, the fragment count and the
+//little endian length of the whole data, so that the receiver can refuse data too long for it
+//before the first fragment is taken. 255 fragments at most.
+#define OBJSHARE_PROTOCOL_MAX_FRAGMENT_SIZE 128
+#define OBJSHARE_PROTOCOL_FRAGMENT_HEADER_SIZE 4
+#define OBJSHARE_PROTOCOL_PDUTYPE_FRAGMENT_FLAG 0x80
+
+// Read request carries the little endian number of bytes the host takes at most; the response
+//carries the object up to that length, so the host knows whether it comes in fragments.
+#define OBJSHARE_PROTOCOL_READ_PARAMETERS_SIZE 2
+
+// Read multi request carries the ids of the objects to be read. Its response starts with a
+//result code and a little endian length for each of them, followed by the data of the objects
+//read, at most MAX_MULTI_DATA_SIZE bytes in total.
+#define OBJSHARE_PROTOCOL_MAX_MULTI_COUNT 16
+#define OBJSHARE_PROTOCOL_MAX_MULTI_DATA_SIZE 256
+#define OBJSHARE_PROTOCOL_MULTI_RESULT_SIZE 3
+
+// Write multi request carries the number of objects in place of the object id, then the object
+//id, little endian length and data of each of them, at most MAX_MULTI_DATA_SIZE bytes in total.
+//Its response is a bitmap of the objects written, first object in the lowest bit.
+#define OBJSHARE_PROTOCOL_MULTI_WRITE_HEADER_SIZE 3
+#define OBJSHARE_PROTOCOL_MULTI_BITMAP_SIZE ((OBJSHARE_PROTOCOL_MAX_MULTI_COUNT + 7) / 8)
+
+// Subscribe request carries the slot it is addressed to, the minimum interval between
+//notifications in ms (little endian) and the deadband (float); without them, it ends the
+//subscription. Notification carries the slot and object id of the subscription, then the data of
+//the object. It is sent by the peripheral unrequested; its sequence number means nothing.
+#define OBJSHARE_PROTOCOL_SUBSCRIBE_PARAMETERS_SIZE 7
+#define OBJSHARE_PROTOCOL_NOTIFY_HEADER_SIZE 2
+
+// Read range request carries the little endian offset and length of the range within the
+//object. Write range request carries the offset followed by the data of the range, at most
+//MAX_MULTI_DATA_SIZE bytes together. Responses are those of read and write requests.
+#define OBJSHARE_PROTOCOL_RANGE_OFFSET_SIZE 2
+#define OBJSHARE_PROTOCOL_READ_RANGE_PARAMETERS_SIZE 4
+
+// Read delta request carries the little endian number of the value the host holds, 0 if it
+//holds none. Its response carries the encoding and the number of the value sent, then either the
+//whole value or its delta against the value the host holds. Delta is a series of tokens: a count
+//of unchanged bytes, a count of changed bytes, then the changed bytes xor'ed with the held
+//ones. Unchanged bytes at the end have no token.
+#define OBJSHARE_PROTOCOL_DELTA_BASELINE_SIZE 2
+#define OBJSHARE_PROTOCOL_DELTA_HEADER_SIZE 3
+#define OBJSHARE_PROTOCOL_DELTA_TOKEN_SIZE 2
+#define OBJSHARE_PROTOCOL_DELTA_ENCODING_FULL 0
+#define OBJSHARE_PROTOCOL_DELTA_ENCODING_XOR_RLE 1
+
+// Read if changed request carries the little endian version of the object the host holds, 0 if
+//it holds none. Its response is the operation result alone when the object is not modified;
+//otherwise it carries the version of the object followed by its data.
+#define OBJSHARE_PROTOCOL_VERSION_SIZE 2
+#define OBJSHARE_PROTOCOL_OPERATION_RESULT_NOT_MODIFIED 0x02
+
+// Get changes request carries the little endian journal sequence the host got last, 0 if none.
+//Its response carries the journal sequence to ask from next, followed by the ids of the objects
+//changed since, each once; ids of every object when the changes are not in the journal any more.
+#define OBJSHARE_PROTOCOL_JOURNAL_SEQUENCE_SIZE 2
+#define OBJSHARE_PROTOCOL_MAX_CHANGE_COUNT OBJSHARE_PROTOCOL_MAX_MULTI_COUNT
+
+	/* Exported types ------------------------------------------------------------*/
+	enum
+	{
+		OBJSHARE_PROTOCOL_STATE_UNINIT = 0,
+		OBJSHARE_PROTOCOL_STATE_READY,
+		OBJSHARE_PROTOCOL_STATE_OPERATING
+	};
+	typedef uint8_t ObjshareProtocol_State_t;
+
+	enum
+	{
+		OBJSHARE_PROTOCOL_PDUTYPE_READ_REQ,
+		OBJSHARE_PROTOCOL_PDUTYPE_READ_RESP,
+		OBJSHARE_PROTOCOL_PDUTYPE_WRITE_REQ,
+		OBJSHARE_PROTOCOL_PDUTYPE_WRITE_RESP,
+		OBJSHARE_PROTOCOL_PDUTYPE_POLL_REQ,
+		OBJSHARE_PROTOCOL_PDUTYPE_POLL_RESP,
+		OBJSHARE_PROTOCOL_PDUTYPE_READ_MULTI_REQ,
+		OBJSHARE_PROTOCOL_PDUTYPE_READ_MULTI_RESP,
+		OBJSHARE_PROTOCOL_PDUTYPE_WRITE_MULTI_REQ,
+		OBJSHARE_PROTOCOL_PDUTYPE_WRITE_MULTI_RESP,
+		OBJSHARE_PROTOCOL_PDUTYPE_WRITE_BROADCAST_REQ,
+		OBJSHARE_PROTOCOL_PDUTYPE_SUBSCRIBE_REQ,
+		OBJSHARE_PROTOCOL_PDUTYPE_SUBSCRIBE_RESP,
+		OBJSHARE_PROTOCOL_PDUTYPE_NOTIFY,
+		OBJSHARE_PROTOCOL_PDUTYPE_READ_RANGE_REQ,
+		OBJSHARE_PROTOCOL_PDUTYPE_READ_RANGE_RESP,
+		OBJSHARE_PROTOCOL_PDUTYPE_WRITE_RANGE_REQ,
+		OBJSHARE_PROTOCOL_PDUTYPE_WRITE_RANGE_RESP,
+		OBJSHARE_PROTOCOL_PDUTYPE_READ_DELTA_REQ,
+		OBJSHARE_PROTOCOL_PDUTYPE_READ_DELTA_RESP,
+		OBJSHARE_PROTOCOL_PDUTYPE_READ_IF_CHANGED_REQ,
+		OBJSHARE_PROTOCOL_PDUTYPE_READ_IF_CHANGED_RESP,
+		OBJSHARE_PROTOCOL_PDUTYPE_GET_CHANGES_REQ,
+		OBJSHARE_PROTOCOL_PDUTYPE_GET_CHANGES_RESP
+	};
+	typedef uint8_t ObjshareProtocol_PduType_t;
+
+	enum
+	{
+		OBJSHARE_PROTOCOL_DIRECTION_TX,
+		OBJSHARE_PROTOCOL_DIRECTION_RX
+	};
+	typedef uint8_t ObjshareProtocol_Direction_t;
+
+	typedef void (*ObjshareProtocol_SwitchDirectionDelegate_t)(ObjshareProtocol_Direction_t direction);
+
+#ifdef OBJSHARE_PROTOCOL_HOST
+	typedef void (*ObjshareProtocol_PduReceivedDelegate_t)(
+		ObjshareProtocol_PduType_t pduType, OperationResult_t operationResult, uint16_t unparsedPduSize);
+#else
+typedef void (*ObjshareProtocol_PduReceivedDelegate_t)(
+	ObjshareProtocol_PduType_t pduType,
+	uint8_t objId, uint16_t unparsedPduSize);
+
+// Gives the buffer the data of a write request to the object is decoded into, from the given
+//offset on, and its capacity; 0 leaves the data in the received pdu.
+typedef uint8_t *(*ObjshareProtocol_PduDataSinkDelegate_t)(uint8_t objId, uint16_t offset,
+														   uint16_t *capacity);
+#endif
+
+/* Exported functions --------------------------------------------------------*/
+#ifdef OBJSHARE_PROTOCOL_HOST
+	extern void ObjshareProtocol_Setup(ObjshareProtocol_PduReceivedDelegate_t pduReceivedEventHandler,
+									   ObjshareProtocol_SwitchDirectionDelegate_t switchDirectionEventHandler);
+#else
+extern void ObjshareProtocol_Setup(ObjshareProtocol_PduReceivedDelegate_t pduReceivedEventHandler,
+								   ObjshareProtocol_SwitchDirectionDelegate_t switchDirectionEventHandler);
+#endif
+	extern void ObjshareProtocol_Start(void);
+	extern void ObjshareProtocol_Execute(void);
+	extern ObjshareProtocol_State_t ObjshareProtocol_GetState(void);
+	extern void ObjshareProtocol_Stop(void);
+	extern void ObjshareProtocol_ParsePduData(uint8_t *data, uint16_t length,
+											  uint16_t unparsedPduSize);
+
+	// Gives the rest of the pdu data in place, valid until the pdu received delegate returns,
+	//and the offset of the data within the object when the pdu is a fragment.
+	extern uint16_t ObjshareProtocol_ViewPduData(uint8_t **data, uint16_t unparsedPduSize);
+	extern uint16_t ObjshareProtocol_GetPduDataOffset(void);
+
+	// Fragmentation state; number of fragments still to be sent, whether the pdu being received
+	//completes its data and the length of its data over all of its fragments.
+	extern uint8_t ObjshareProtocol_GetPendingFragmentCount(void);
+	extern Bool_t ObjshareProtocol_IsLastFragment(void);
+	extern uint16_t ObjshareProtocol_GetDataLength(void);
+
+	// Sequence number of the pdu being received.
+	extern uint8_t ObjshareProtocol_GetPduSequence(void);
+
+#ifdef OBJSHARE_PROTOCOL_PERIPHERAL
+	// Write data is streamed into the sink when the packet manager is built with
+	//PACKET_MANAGER_STREAM; ignored otherwise.
+	extern void ObjshareProtocol_SetPduDataSinkDelegate(ObjshareProtocol_PduDataSinkDelegate_t pduDataSinkHandler);
+#endif
+
+#if defined(OBJSHARE_PROTOCOL_HOST)
+	extern Bool_t ObjshareProtocol_Send(uint8_t slot,
+										ObjshareProtocol_PduType_t pduType,
+										uint8_t sequence,
+										uint8_t objId, uint8_t *data,
+										uint16_t dataLength);
+#else
+// Response carries the sequence number of the last pdu received; so does a notification.
+extern Bool_t ObjshareProtocol_Send(ObjshareProtocol_PduType_t pduType,
+									OperationResult_t operationResult,
+									uint8_t *data, uint16_t dataLength);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -2,17 +2,69 @@
  * @author     Onur Efe
  */
 /* Includes ------------------------------------------------------------------*/
+#include <string.h>
 #include "serial.h"
 #include "packet_manager.h"
 #include "crc.h"
+#include "trace.h"
+
+// Special character scan is vectorized where the target offers it; scalar lookup otherwise.
+#if defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 /* Private constants ---------------------------------------------------------*/
-#define MAX_PACKET_SIZE SERIAL_RING_BUFFER_SIZE
+#define MAX_PACKET_SIZE PACKET_MANAGER_MAX_FRAME_SIZE
+
+// Frame check sequence; the residue of a valid frame, crc code included, is zero.
+#ifdef PACKET_MANAGER_CRC32C
+#define FRAME_CRC_SEED 0xFFFFFFFFUL
+#define FRAME_CRC_UPDATE(crc, data) CRC_Update32C(crc, data)
+#define FRAME_CRC_CALCULATE(crc, buff, size) CRC_Calculate32C(crc, buff, size)
+// Least significant byte first, reflected algorithm.
+#define FRAME_CRC_BYTE(crc, idx) ((uint8_t)((crc) >> (8 * (idx))))
+#else
+#define FRAME_CRC_SEED 0xFFFF
+#define FRAME_CRC_UPDATE(crc, data) CRC_Update16(crc, data)
+#define FRAME_CRC_CALCULATE(crc, buff, size) CRC_Calculate16(crc, buff, size)
+// Most significant byte first.
+#define FRAME_CRC_BYTE(crc, idx) ((uint8_t)((crc) >> (8 * (1 - (idx)))))
+#endif
+
+// Consistent overhead byte stuffing; a block code byte tells the distance to the next zero.
+#define COBS_DELIMITER 0x00
+#define COBS_MAX_BLOCK_LENGTH 254
+
+// Length header follows the start character; 7 bits per byte with the top bit set, so that
+//it is never taken for a special character.
+#define LENGTH_HEADER_SIZE 2
+#define LENGTH_HEADER_MARK 0x80
+
+#if defined(PACKET_MANAGER_COBS) && defined(PACKET_MANAGER_LENGTH_HEADER)
+#error "PACKET_MANAGER_LENGTH_HEADER applies to escape framing only"
+#endif
+
+#if defined(PACKET_MANAGER_STREAM) && (defined(PACKET_MANAGER_COBS) || defined(PACKET_MANAGER_LENGTH_HEADER))
+#error "PACKET_MANAGER_STREAM applies to escape framing only"
+#endif
+
+// Bumps a link counter; the generation tells a snapshot in progress to copy again.
+#ifdef PACKET_MANAGER_STATS
+#define STATS_ADD(counter, value) \
+	do                            \
+	{                             \
+		Stats.counter += (value); \
+		StatsGeneration++;        \
+	} while (0)
+#else
+#define STATS_ADD(counter, value) ((void)0)
+#endif
 
 /* Private typedefs ----------------------------------------------------------*/
 enum
 {
-	VOID_CHARACTER = SERIAL_VOID_CHARACTER,
 	START_CHARACTER = 0x0D,
 	TERMINATE_CHARACTER = 0x3A,
 	ESCAPE_CHARACTER = 0x3B
@@ -23,34 +75,177 @@ enum
 {
 	START_CHARACTER_CODE = 0x00,
 	TERMINATE_CHARACTER_CODE = 0x01,
-	ESCAPE_CHARACTER_CODE = 0x02,
-	VOID_CHARACTER_CODE = 0x03
+	ESCAPE_CHARACTER_CODE = 0x02
 };
 typedef uint8_t SpecialCharacterEscapeCode_t;
 
+enum
+{
+	CHARACTER_CLASS_DATA = 0x00,
+	CHARACTER_CLASS_START,
+	CHARACTER_CLASS_TERMINATE,
+	CHARACTER_CLASS_ESCAPE
+};
+typedef uint8_t CharacterClass_t;
+
+enum
+{
+	ENCODER_STAGE_START = 0,
+	ENCODER_STAGE_LENGTH,
+	ENCODER_STAGE_BLOCK_CODE,
+	ENCODER_STAGE_FIELDS,
+	ENCODER_STAGE_CRC,
+	ENCODER_STAGE_TERMINATE,
+	ENCODER_STAGE_DONE
+};
+typedef uint8_t EncoderStage_t;
+
+enum
+{
+	DECODER_STAGE_HUNT = 0,
+	DECODER_STAGE_LENGTH,
+	DECODER_STAGE_BODY,
+	DECODER_STAGE_TERMINATE
+};
+typedef uint8_t DecoderStage_t;
+
+#ifdef PACKET_MANAGER_CRC32C
+typedef uint32_t FrameCrc_t;
+#else
+typedef uint16_t FrameCrc_t;
+#endif
+
+// Frame waiting for transmission. Fields short enough are copied into header, the rest are
+//referenced and encoded from the caller's memory at transmission time.
+typedef struct
+{
+	PacketManager_PduField_t fields[PACKET_MANAGER_MAX_PDU_FIELD_COUNT];
+	uint8_t fieldCount;
+	uint8_t header[PACKET_MANAGER_FRAME_HEADER_SIZE];
+} Frame_t;
+
 /* Private function prototypes -----------------------------------------------*/
+#ifdef PACKET_MANAGER_COBS
+static uint8_t *frameSegment(Frame_t *frame, uint8_t idx, uint16_t *length);
+static uint8_t cobsBlockLength(Frame_t *frame, Bool_t *zeroFollows);
+static Bool_t cobsDecode(uint8_t *data, uint16_t *length);
+#else
+#ifndef PACKET_MANAGER_LENGTH_HEADER
 static uint8_t decode(uint8_t element);
-static void encodeToBuffer(uint8_t *src, uint8_t *dest, uint16_t srcLength,
-						   uint16_t *destLength);
-static void serialEventHandler(Serial_Event_t event, uint8_t *data,
-							   uint16_t length);
+#endif
+static uint16_t findSpecial(uint8_t *data, uint16_t length);
+static uint16_t encodeToBuffer(uint8_t *src, uint8_t *dest, uint16_t srcLength,
+							   uint16_t destSize, uint16_t *destLength, FrameCrc_t *crc);
+#endif
+#ifdef PACKET_MANAGER_STREAM
+static void checkStream(void);
+#endif
+static uint16_t encodeChunk(Frame_t *frame, uint8_t *dest, uint16_t destSize);
+static void decodeSpan(uint8_t *data, uint16_t length);
+static void resetDecoder(void);
+static void serialEventHandler(Serial_Event_t event, Serial_Span_t *spans,
+							   uint8_t spanCount);
+static void txDataRequestEventHandler(Serial_Span_t *span);
+
+#ifdef PACKET_MANAGER_TEST
+static void testPduReceivedEventHandler(PacketManager_Event_t event, uint16_t unparsedPduSize);
+#ifdef PACKET_MANAGER_STREAM
+static uint16_t testStreamEventHandler(uint8_t *header, uint16_t headerLength,
+									   PacketManager_PduField_t *sink);
+#endif
+#endif
 
 /* Private variables ---------------------------------------------------------*/
+#ifndef PACKET_MANAGER_COBS
+// Lookup tables replacing the per byte switches of the encoder and decoder.
+static const CharacterClass_t CharacterClassTable[256] = {
+	[START_CHARACTER] = CHARACTER_CLASS_START,
+	[TERMINATE_CHARACTER] = CHARACTER_CLASS_TERMINATE,
+	[ESCAPE_CHARACTER] = CHARACTER_CLASS_ESCAPE};
+#endif
+
+#if !defined(PACKET_MANAGER_COBS) && !defined(PACKET_MANAGER_LENGTH_HEADER)
+static const SpecialCharacterEscapeCode_t EscapeCodeTable[] = {
+	[CHARACTER_CLASS_START] = START_CHARACTER_CODE,
+	[CHARACTER_CLASS_TERMINATE] = TERMINATE_CHARACTER_CODE,
+	[CHARACTER_CLASS_ESCAPE] = ESCAPE_CHARACTER_CODE};
+
+static const SpecialCharacter_t DecodeTable[] = {
+	[START_CHARACTER_CODE] = START_CHARACTER,
+	[TERMINATE_CHARACTER_CODE] = TERMINATE_CHARACTER,
+	[ESCAPE_CHARACTER_CODE] = ESCAPE_CHARACTER};
+#endif
+
 static PacketManager_EventOccurredDelegate_t EventOccurredDelegate;
 
 static uint8_t State = PACKET_MANAGER_STATE_UNINIT;
 
 static uint8_t Inbox[MAX_PACKET_SIZE];
-static uint8_t InboxDataLength;
-static uint8_t InboxIdx;
-static uint8_t InboxParseIdx;
+static uint16_t InboxIdx;
+static uint16_t InboxParseIdx;
+
+// Buffer the frame is decoded into; InboxIdx indexes it. Unless the frame is streamed, it is
+//the inbox itself and there is no header.
+static uint8_t *RxBuffer = Inbox;
+static uint16_t RxBufferSize = MAX_PACKET_SIZE;
+static uint16_t RxHeaderLength;
+#ifdef PACKET_MANAGER_STREAM
+static PacketManager_StreamDelegate_t StreamDelegate;
+static uint16_t StreamCheckLength;
+#endif
+#if !defined(PACKET_MANAGER_COBS) && !defined(PACKET_MANAGER_LENGTH_HEADER)
+static FrameCrc_t InboxCrc;
+#endif
+#ifdef PACKET_MANAGER_LENGTH_HEADER
+static uint8_t InboxHeader[LENGTH_HEADER_SIZE];
+static uint8_t InboxHeaderIdx;
+static uint16_t InboxLength;
+static DecoderStage_t DecoderStage;
+#endif
 
-static uint8_t Outbox[MAX_PACKET_SIZE];
-static uint8_t OutboxDataLength;
-static uint8_t OutboxIdx;
+// Queue of frames. Head is advanced by the transmitter (interrupt), tail by senders.
+static Frame_t Outbox[PACKET_MANAGER_TX_QUEUE_LENGTH];
+static volatile uint8_t OutboxHead;
+static volatile uint8_t OutboxTail;
 
+// Staging buffer the head frame is escaped into, chunk by chunk, as the transmitter asks for it.
+static uint8_t TxChunk[PACKET_MANAGER_TX_CHUNK_SIZE];
+
+// Streaming encoder state of the head frame.
+static EncoderStage_t EncoderStage;
+static uint8_t EncoderFieldIdx;
+static uint16_t EncoderByteIdx;
+static FrameCrc_t EncoderCrc;
+#ifdef PACKET_MANAGER_COBS
+static uint8_t EncoderCrcBytes[sizeof(FrameCrc_t)];
+static uint8_t EncoderBlockRemaining;
+static Bool_t EncoderZeroFollows;
+#endif
+
+#ifndef PACKET_MANAGER_LENGTH_HEADER
 static Bool_t PacketStartedFlag;
+#endif
+
+#ifdef PACKET_MANAGER_STATS
+// Receive counters are updated from the main loop, transmit counters mostly from the
+//transmitter's interrupt; each counter has a single writer.
+static volatile PacketManager_Stats_t Stats;
+static volatile uint32_t StatsGeneration;
+#endif
+#if !defined(PACKET_MANAGER_COBS) && !defined(PACKET_MANAGER_LENGTH_HEADER)
 static Bool_t EscapeMode;
+#endif
+
+#ifdef PACKET_MANAGER_TEST
+// Every special character is in the payload, between clean runs long enough for the vectorized
+//scan; second byte holds the frame's sequence number.
+static uint8_t TestPayload[40];
+static uint8_t TestReceivedCount;
+static Bool_t TestMismatch;
+#ifdef PACKET_MANAGER_STREAM
+static uint8_t TestSink[sizeof(TestPayload) + sizeof(FrameCrc_t)];
+#endif
+#endif
 
 /* Exported functions --------------------------------------------------------*/
 /***
@@ -63,7 +258,7 @@ void PacketManager_Setup(PacketManager_EventOccurredDelegate_t eventHandler)
 	EventOccurredDelegate = eventHandler;
 
 	// Register delegates.
-	Serial_Setup(&serialEventHandler);
+	Serial_Setup(&serialEventHandler, &txDataRequestEventHandler);
 
 	State = PACKET_MANAGER_STATE_READY;
 }
@@ -80,14 +275,11 @@ Bool_t PacketManager_Start(void)
 	}
 
 	// Clear buffers.
-	InboxDataLength = 0;
-	InboxIdx = 0;
-	OutboxIdx = 0;
-	OutboxDataLength = 0;
+	OutboxHead = 0;
+	OutboxTail = 0;
+	EncoderStage = ENCODER_STAGE_START;
 
-	// Clear flags.
-	EscapeMode = FALSE;
-	PacketStartedFlag = FALSE;
+	resetDecoder();
 
 	State = PACKET_MANAGER_STATE_OPERATING;
 
@@ -115,51 +307,55 @@ void PacketManager_Stop(void)
 	State = PACKET_MANAGER_STATE_READY;
 }
 
-void PacketManager_Send(PacketManager_PduField_t *pduFields,
-						uint8_t pduFieldCount)
+Bool_t PacketManager_Send(PacketManager_PduField_t *pduFields,
+						  uint8_t pduFieldCount)
 {
 	// Discard if not operating.
 	if (State != PACKET_MANAGER_STATE_OPERATING)
 	{
-		return;
+		return FALSE;
 	}
 
-	// Check if there is any data waiting.
-	if ((OutboxDataLength != 0) && (OutboxDataLength != OutboxIdx))
+	if (pduFieldCount > PACKET_MANAGER_MAX_PDU_FIELD_COUNT)
 	{
-		return;
+		return FALSE;
 	}
 
-	uint16_t crc_code = 0xFFFF;
-	uint8_t outbox_idx = 0;
-	uint16_t __dest_length;
+	// Refuse if all slots are waiting for transmission.
+	if ((uint8_t)(OutboxTail - OutboxHead) == PACKET_MANAGER_TX_QUEUE_LENGTH)
+	{
+		STATS_ADD(txQueueFull, 1);
+		return FALSE;
+	}
 
-	Outbox[outbox_idx++] = START_CHARACTER;
+	Frame_t *frame = &Outbox[OutboxTail % PACKET_MANAGER_TX_QUEUE_LENGTH];
+	uint8_t header_idx = 0;
 
-	// Encode and enqueue pdu fields..
+	// Keep the gather list; copy the fields which fit into the header since they may live on
+	//the caller's stack.
 	for (uint8_t i = 0; i < pduFieldCount; i++)
 	{
-		encodeToBuffer(pduFields[i].data, &Outbox[outbox_idx],
-					   pduFields[i].length, &__dest_length);
-		outbox_idx += __dest_length;
+		frame->fields[i] = pduFields[i];
 
-		crc_code = CRC_Calculate16(crc_code, pduFields[i].data,
-								   pduFields[i].length);
-	}
+		if (pduFields[i].length <= (PACKET_MANAGER_FRAME_HEADER_SIZE - header_idx))
+		{
+			for (uint16_t j = 0; j < pduFields[i].length; j++)
+			{
+				frame->header[header_idx + j] = pduFields[i].data[j];
+			}
 
-	// Encode and enqueue crc code.
-	encodeToBuffer(&((uint8_t *)&crc_code)[1], &Outbox[outbox_idx],
-				   sizeof(uint8_t), &__dest_length);
-	outbox_idx += __dest_length;
+			frame->fields[i].data = &frame->header[header_idx];
+			header_idx += pduFields[i].length;
+		}
+	}
 
-	encodeToBuffer(&((uint8_t *)&crc_code)[0], &Outbox[outbox_idx],
-				   sizeof(uint8_t), &__dest_length);
-	outbox_idx += __dest_length;
+	frame->fieldCount = pduFieldCount;
+	OutboxTail++;
 
-	Outbox[outbox_idx++] = TERMINATE_CHARACTER;
+	// Start transmission if the line is idle.
+	Serial_Transmit();
 
-	OutboxDataLength = outbox_idx;
-	OutboxIdx = 0;
+	return TRUE;
 }
 
 uint16_t PacketManager_ParseField(uint8_t *data, uint16_t length,
@@ -167,44 +363,222 @@ uint16_t PacketManager_ParseField(uint8_t *data, uint16_t length,
 {
 	uint16_t parse_length =
 		(unparsedPduSize < length) ? unparsedPduSize : length;
+	PacketManager_PduField_t field;
 
-	for (uint16_t i = 0; i < parse_length; i++)
+	// Field of a streamed frame may start in the inbox and continue in the sink.
+	for (uint16_t i = 0; i < parse_length; i += field.length)
 	{
-		data[i] = Inbox[InboxParseIdx++];
+		PacketManager_ViewField(&field, parse_length - i, parse_length - i);
+		memcpy(&data[i], field.data, field.length);
 	}
 
 	return (unparsedPduSize - parse_length);
 }
 
+uint16_t PacketManager_ViewField(PacketManager_PduField_t *field, uint16_t length,
+								 uint16_t unparsedPduSize)
+{
+	field->length = (unparsedPduSize < length) ? unparsedPduSize : length;
+
+	if (InboxParseIdx < RxHeaderLength)
+	{
+		// Header of a streamed frame; view ends where the sink begins.
+		field->data = &Inbox[InboxParseIdx];
+		field->length = ((RxHeaderLength - InboxParseIdx) < field->length) ? (RxHeaderLength - InboxParseIdx)
+																			: field->length;
+	}
+	else
+	{
+		field->data = &RxBuffer[InboxParseIdx - RxHeaderLength];
+	}
+
+	InboxParseIdx += field->length;
+
+	return (unparsedPduSize - field->length);
+}
+
+#ifdef PACKET_MANAGER_STREAM
+void PacketManager_SetStreamDelegate(PacketManager_StreamDelegate_t streamHandler)
+{
+	StreamDelegate = streamHandler;
+}
+#endif
+
+#ifdef PACKET_MANAGER_STATS
+void PacketManager_GetStats(PacketManager_Stats_t *stats)
+{
+	uint32_t generation;
+
+	// Copy again if the interrupt updated a counter meanwhile, so that the counters belong
+	//to the same moment.
+	do
+	{
+		generation = StatsGeneration;
+		*stats = Stats;
+	} while (generation != StatsGeneration);
+}
+#endif
+
 void PacketManager_ErrorHandler(void)
 {
 	// Set state to ready.
 	State = PACKET_MANAGER_STATE_READY;
 }
 
-/* Private functions ---------------------------------------------------------*/
-static void serialEventHandler(Serial_Event_t event, uint8_t *data,
-							   uint16_t length)
+#ifdef PACKET_MANAGER_TEST
+// Feeds a completely full receive ring in two spans, as the serial layer does when the data
+//wraps. Frames are laid back to back from every start offset, so the wrap point falls on each
+//byte of a frame, escape sequences included.
+Bool_t PacketManager_Test(void)
 {
-	switch (event)
+	PacketManager_EventOccurredDelegate_t event_occurred_delegate = EventOccurredDelegate;
+#ifdef PACKET_MANAGER_STREAM
+	PacketManager_StreamDelegate_t stream_delegate = StreamDelegate;
+
+	// Every frame is streamed past its third byte, escaped ones among them.
+	StreamDelegate = testStreamEventHandler;
+#endif
+	Frame_t test_frame = {{{TestPayload, sizeof(TestPayload)}}, 1};
+	uint8_t frame[MAX_PACKET_SIZE];
+	uint8_t ring[SERIAL_RING_BUFFER_SIZE];
+	Serial_Span_t spans[2];
+	Bool_t result = TRUE;
+
+	EventOccurredDelegate = testPduReceivedEventHandler;
+
+	for (uint8_t i = 0; i < sizeof(TestPayload); i++)
 	{
-	case SERIAL_EVENT_TX_IDLE:
+		TestPayload[i] = 0x40 + i;
+	}
+
+	TestPayload[0] = START_CHARACTER;
+	TestPayload[2] = TERMINATE_CHARACTER;
+	TestPayload[3] = ESCAPE_CHARACTER;
+	TestPayload[4] = 0xAA;
+	TestPayload[5] = 0x00;
+	TestPayload[37] = ESCAPE_CHARACTER;
+
+	for (uint16_t offset = 0; offset < SERIAL_RING_BUFFER_SIZE; offset++)
 	{
-		uint16_t awaiting_element_count = OutboxDataLength - OutboxIdx;
+		uint16_t ring_length = 0;
+		uint8_t frame_count = 0;
+
+		while (TRUE)
+		{
+			TestPayload[1] = frame_count;
+
+			EncoderStage = ENCODER_STAGE_START;
+
+			uint16_t frame_length = encodeChunk(&test_frame, frame, sizeof(frame));
+
+			if ((ring_length + frame_length) > SERIAL_RING_BUFFER_SIZE)
+			{
+				break;
+			}
+
+			for (uint16_t i = 0; i < frame_length; i++)
+			{
+				ring[(offset + ring_length++) % SERIAL_RING_BUFFER_SIZE] = frame[i];
+			}
+
+			frame_count++;
+		}
+
+		// Fill the rest with idle line data.
+		while (ring_length < SERIAL_RING_BUFFER_SIZE)
+		{
+			ring[(offset + ring_length++) % SERIAL_RING_BUFFER_SIZE] = 0x00;
+		}
+
+		spans[0].data = &ring[offset];
+		spans[0].length = SERIAL_RING_BUFFER_SIZE - offset;
+		spans[1].data = ring;
+		spans[1].length = offset;
+
+		resetDecoder();
+		TestReceivedCount = 0;
+		TestMismatch = FALSE;
 
-		if (awaiting_element_count)
+#ifdef PACKET_MANAGER_STATS
+		uint32_t rx_frames = Stats.rxFrames;
+#endif
+
+		serialEventHandler(SERIAL_EVENT_DATA_READY, spans, offset ? 2 : 1);
+
+#ifdef PACKET_MANAGER_STATS
+		// Every frame delivered is counted.
+		TestMismatch = ((Stats.rxFrames - rx_frames) != TestReceivedCount) ? TRUE : TestMismatch;
+#endif
+
+		if (TestMismatch || (TestReceivedCount != frame_count))
 		{
-			uint16_t bytes_to_write =
-				(length < awaiting_element_count) ? length : awaiting_element_count;
-			bytes_to_write =
-				(MAX_PACKET_SIZE < bytes_to_write) ? MAX_PACKET_SIZE : bytes_to_write;
+			result = FALSE;
+			break;
+		}
+	}
+
+	EventOccurredDelegate = event_occurred_delegate;
+#ifdef PACKET_MANAGER_STREAM
+	StreamDelegate = stream_delegate;
+#endif
+
+	return result;
+}
+
+static void testPduReceivedEventHandler(PacketManager_Event_t event, uint16_t unparsedPduSize)
+{
+	uint8_t payload[sizeof(TestPayload)];
 
-			Serial_Send(&Outbox[OutboxIdx], bytes_to_write);
-			OutboxIdx += bytes_to_write;
+	if ((event != PACKET_MANAGER_PDU_RECEIVED_EVENT) || (unparsedPduSize != sizeof(payload)))
+	{
+		TestMismatch = TRUE;
+		return;
+	}
+
+#ifdef PACKET_MANAGER_STREAM
+	if (RxBuffer != TestSink)
+	{
+		TestMismatch = TRUE;
+	}
+#endif
+
+	PacketManager_ParseField(payload, sizeof(payload), unparsedPduSize);
+
+	TestPayload[1] = TestReceivedCount++;
+
+	for (uint8_t i = 0; i < sizeof(payload); i++)
+	{
+		if (payload[i] != TestPayload[i])
+		{
+			TestMismatch = TRUE;
 		}
 	}
-	break;
+}
+
+#ifdef PACKET_MANAGER_STREAM
+static uint16_t testStreamEventHandler(uint8_t *header, uint16_t headerLength,
+									   PacketManager_PduField_t *sink)
+{
+	// Ask for more first, so that the check is resumed as well.
+	if (headerLength < 3)
+	{
+		return 3;
+	}
+
+	sink->data = TestSink;
+	sink->length = sizeof(TestSink);
 
+	return 0;
+}
+#endif
+#endif
+
+/* Private functions ---------------------------------------------------------*/
+static void serialEventHandler(Serial_Event_t event, Serial_Span_t *spans,
+							   uint8_t spanCount)
+{
+	switch (event)
+	{
 	case SERIAL_EVENT_TX_COMPLETED:
 	{
 		EventOccurredDelegate ? EventOccurredDelegate(PACKET_MANAGER_TRANSMISSION_COMPLETED_EVENT, 0) : (void)0;
@@ -213,149 +587,839 @@ static void serialEventHandler(Serial_Event_t event, uint8_t *data,
 
 	case SERIAL_EVENT_DATA_READY:
 	{
-		for (uint8_t i = 0; i < length; i++)
+		for (uint8_t i = 0; i < spanCount; i++)
+		{
+			decodeSpan(spans[i].data, spans[i].length);
+		}
+	}
+	break;
+
+	case SERIAL_EVENT_ERROR_OCCURRED:
+	{
+		State = PACKET_MANAGER_STATE_ERROR;
+		Serial_Stop();
+
+		EventOccurredDelegate ? EventOccurredDelegate(PACKET_MANAGER_ERROR_OCCURRED_EVENT, 0) : (void)0;
+	}
+	break;
+	}
+}
+
+static void txDataRequestEventHandler(Serial_Span_t *span)
+{
+	uint16_t length = 0;
+
+	// Escape queued frames into the staging buffer; a frame's slot is released as soon as it
+	//is completely encoded, and the next one continues in the same chunk.
+	while ((OutboxTail != OutboxHead) && (length < PACKET_MANAGER_TX_CHUNK_SIZE))
+	{
+		if (EncoderStage == ENCODER_STAGE_START)
 		{
-			switch (data[i])
+			TRACE(TRACE_EVENT_FRAME_START, 1, 0);
+		}
+
+		length += encodeChunk(&Outbox[OutboxHead % PACKET_MANAGER_TX_QUEUE_LENGTH],
+							  &TxChunk[length], PACKET_MANAGER_TX_CHUNK_SIZE - length);
+
+		if (EncoderStage != ENCODER_STAGE_DONE)
+		{
+			break;
+		}
+
+		EncoderStage = ENCODER_STAGE_START;
+		OutboxHead++;
+
+		STATS_ADD(txFrames, 1);
+		TRACE(TRACE_EVENT_FRAME_END, 1, 0);
+	}
+
+	if (length)
+	{
+		span->data = TxChunk;
+		span->length = length;
+	}
+}
+
+#ifndef PACKET_MANAGER_COBS
+// Continues encoding the frame until it ends or dest is full. Returns the encoded length.
+static uint16_t encodeChunk(Frame_t *frame, uint8_t *dest, uint16_t destSize)
+{
+	uint16_t dest_idx = 0;
+	uint16_t __dest_length;
+
+	// Any element takes two bytes at most.
+	while ((EncoderStage != ENCODER_STAGE_DONE) && ((destSize - dest_idx) >= 2))
+	{
+		switch (EncoderStage)
+		{
+		case ENCODER_STAGE_START:
+		{
+			dest[dest_idx++] = START_CHARACTER;
+
+			EncoderCrc = FRAME_CRC_SEED;
+			EncoderFieldIdx = 0;
+			EncoderByteIdx = 0;
+#ifdef PACKET_MANAGER_LENGTH_HEADER
+			EncoderStage = ENCODER_STAGE_LENGTH;
+#else
+			EncoderStage = ENCODER_STAGE_FIELDS;
+#endif
+		}
+		break;
+
+#ifdef PACKET_MANAGER_LENGTH_HEADER
+		case ENCODER_STAGE_LENGTH:
+		{
+			uint16_t length = sizeof(EncoderCrc);
+
+			for (uint8_t i = 0; i < frame->fieldCount; i++)
 			{
-			case START_CHARACTER:
+				length += frame->fields[i].length;
+			}
+
+			// Most significant bits first.
+			dest[dest_idx++] = LENGTH_HEADER_MARK | (uint8_t)((length >> 7) & 0x7F);
+			dest[dest_idx++] = LENGTH_HEADER_MARK | (uint8_t)(length & 0x7F);
+			EncoderStage = ENCODER_STAGE_FIELDS;
+		}
+		break;
+#endif
+
+		case ENCODER_STAGE_FIELDS:
+		{
+			if (EncoderFieldIdx == frame->fieldCount)
 			{
-				InboxDataLength = 0;
-				InboxIdx = 0;
-				EscapeMode = FALSE;
-				PacketStartedFlag = TRUE;
+				EncoderStage = ENCODER_STAGE_CRC;
+				break;
 			}
-			break;
 
-			case TERMINATE_CHARACTER:
+			PacketManager_PduField_t *field = &frame->fields[EncoderFieldIdx];
+
+			EncoderByteIdx += encodeToBuffer(&field->data[EncoderByteIdx], &dest[dest_idx],
+											 field->length - EncoderByteIdx,
+											 destSize - dest_idx, &__dest_length, &EncoderCrc);
+			dest_idx += __dest_length;
+
+			if (EncoderByteIdx == field->length)
+			{
+				EncoderFieldIdx++;
+				EncoderByteIdx = 0;
+			}
+		}
+		break;
+
+		case ENCODER_STAGE_CRC:
+		{
+			uint8_t crc_byte = FRAME_CRC_BYTE(EncoderCrc, EncoderByteIdx);
+
+			encodeToBuffer(&crc_byte, &dest[dest_idx], sizeof(crc_byte),
+						   destSize - dest_idx, &__dest_length, 0);
+			dest_idx += __dest_length;
+
+			if (++EncoderByteIdx == sizeof(EncoderCrc))
+			{
+				EncoderStage = ENCODER_STAGE_TERMINATE;
+			}
+		}
+		break;
+
+		case ENCODER_STAGE_TERMINATE:
+		{
+			dest[dest_idx++] = TERMINATE_CHARACTER;
+			EncoderStage = ENCODER_STAGE_DONE;
+		}
+		break;
+		}
+	}
+
+	return dest_idx;
+}
+
+#ifdef PACKET_MANAGER_LENGTH_HEADER
+// Hunts for a start character, copies exactly the number of bytes given by the header and
+//validates the frame at once. Any mismatch sends the decoder back to hunting.
+static void decodeSpan(uint8_t *data, uint16_t length)
+{
+	uint16_t i = 0;
+
+	while (i < length)
+	{
+		switch (DecoderStage)
+		{
+		case DECODER_STAGE_HUNT:
+		{
+			i += findSpecial(&data[i], length - i);
+
+			if ((i < length) && (data[i++] == START_CHARACTER))
 			{
-				if (PacketStartedFlag)
+				InboxHeaderIdx = 0;
+				DecoderStage = DECODER_STAGE_LENGTH;
+			}
+		}
+		break;
+
+		case DECODER_STAGE_LENGTH:
+		{
+			InboxHeader[InboxHeaderIdx] = data[i++];
+
+			// Start character restarts the frame; anything else without the mark is out of sync.
+			if (!(InboxHeader[InboxHeaderIdx] & LENGTH_HEADER_MARK))
+			{
+				DecoderStage = (InboxHeader[InboxHeaderIdx] == START_CHARACTER) ? DECODER_STAGE_LENGTH
+																				 : DECODER_STAGE_HUNT;
+				InboxHeaderIdx = 0;
+				break;
+			}
+
+			if (++InboxHeaderIdx == LENGTH_HEADER_SIZE)
+			{
+				InboxLength = ((uint16_t)(InboxHeader[0] & ~LENGTH_HEADER_MARK) << 7) |
+							  (InboxHeader[1] & ~LENGTH_HEADER_MARK);
+				InboxIdx = 0;
+
+				DecoderStage = ((InboxLength >= sizeof(FrameCrc_t)) && (InboxLength <= MAX_PACKET_SIZE))
+								   ? DECODER_STAGE_BODY
+								   : DECODER_STAGE_HUNT;
+
+				if (InboxLength > MAX_PACKET_SIZE)
 				{
-					// Validate pdu.
-					if (!CRC_Calculate16(0xFFFF, Inbox, InboxIdx))
-					{
-						InboxParseIdx = 0;
-
-						// Call event occurred delegate.
-						EventOccurredDelegate ? EventOccurredDelegate(
-													PACKET_MANAGER_PDU_RECEIVED_EVENT,
-													InboxIdx - sizeof(uint16_t))
-											  : (void)0;
-					}
-
-					PacketStartedFlag = FALSE;
+					STATS_ADD(rxOverflows, 1);
 				}
+
+				TRACE(TRACE_EVENT_FRAME_START, 0, 0);
 			}
-			break;
+		}
+		break;
+
+		case DECODER_STAGE_BODY:
+		{
+			uint16_t copy_length = InboxLength - InboxIdx;
+
+			copy_length = ((length - i) < copy_length) ? (length - i) : copy_length;
+
+			memcpy(&Inbox[InboxIdx], &data[i], copy_length);
+			InboxIdx += copy_length;
+			i += copy_length;
+
+			if (InboxIdx == InboxLength)
+			{
+				DecoderStage = DECODER_STAGE_TERMINATE;
+			}
+		}
+		break;
+
+		case DECODER_STAGE_TERMINATE:
+		{
+			uint8_t element = data[i++];
+
+			// Validate pdu; the residue of a valid pdu, crc code included, is zero.
+			if ((element == TERMINATE_CHARACTER) &&
+				!FRAME_CRC_CALCULATE(FRAME_CRC_SEED, Inbox, InboxIdx))
+			{
+				InboxParseIdx = 0;
+				STATS_ADD(rxFrames, 1);
+				TRACE(TRACE_EVENT_FRAME_END, 0, InboxIdx - sizeof(FrameCrc_t));
+
+				// Call event occurred delegate.
+				EventOccurredDelegate ? EventOccurredDelegate(
+											PACKET_MANAGER_PDU_RECEIVED_EVENT,
+											InboxIdx - sizeof(FrameCrc_t))
+									  : (void)0;
+			}
+			else
+			{
+				STATS_ADD(rxCrcErrors, 1);
+				TRACE(TRACE_EVENT_CRC_FAIL, 0, InboxIdx);
+			}
+
+			InboxHeaderIdx = 0;
+			DecoderStage = (element == START_CHARACTER) ? DECODER_STAGE_LENGTH : DECODER_STAGE_HUNT;
+		}
+		break;
+		}
+	}
+}
+#else
+static void decodeSpan(uint8_t *data, uint16_t length)
+{
+	uint16_t i = 0;
+
+	while (i < length)
+	{
+		// Escaped element.
+		if (EscapeMode && PacketStartedFlag &&
+			(CharacterClassTable[data[i]] == CHARACTER_CLASS_DATA))
+		{
+			EscapeMode = FALSE;
 
-			case ESCAPE_CHARACTER:
+			// Discard this packet since it exceeded the packet size. Streamed one is kept being
+			//checked past its sink.
+			if ((InboxIdx >= RxBufferSize) && !RxHeaderLength)
 			{
-				EscapeMode = TRUE;
+				PacketStartedFlag = FALSE;
+				STATS_ADD(rxOverflows, 1);
 			}
+			else
+			{
+				uint8_t element = decode(data[i]);
+
+				(InboxIdx < RxBufferSize) ? (void)(RxBuffer[InboxIdx] = element) : (void)0;
+				InboxCrc = FRAME_CRC_UPDATE(InboxCrc, element);
+				InboxIdx++;
+				STATS_ADD(rxEscapes, 1);
+			}
+
+			i++;
+			continue;
+		}
+
+		// Copy the run until the next special character at once.
+		uint16_t run_length = findSpecial(&data[i], length - i);
+
+#ifdef PACKET_MANAGER_STREAM
+		// Stop where the stream delegate is to look at the header.
+		if (StreamCheckLength && PacketStartedFlag && (run_length > (StreamCheckLength - InboxIdx)))
+		{
+			run_length = StreamCheckLength - InboxIdx;
+		}
+#endif
+
+		if (run_length && PacketStartedFlag)
+		{
+			// Discard this packet since it exceeded the packet size. Streamed one is kept being
+			//checked past its sink.
+			if (!RxHeaderLength && (run_length > (RxBufferSize - InboxIdx)))
+			{
+				PacketStartedFlag = FALSE;
+				STATS_ADD(rxOverflows, 1);
+			}
+			else
+			{
+				uint16_t keep_length = (InboxIdx < RxBufferSize) ? (RxBufferSize - InboxIdx) : 0;
+				keep_length = (run_length < keep_length) ? run_length : keep_length;
+
+				memcpy(&RxBuffer[InboxIdx], &data[i], keep_length);
+				InboxCrc = FRAME_CRC_CALCULATE(InboxCrc, &data[i], run_length);
+				InboxIdx += run_length;
+			}
+		}
+
+		i += run_length;
+
+#ifdef PACKET_MANAGER_STREAM
+		if (StreamCheckLength && PacketStartedFlag && (InboxIdx == StreamCheckLength))
+		{
+			checkStream();
+			continue;
+		}
+#endif
+
+		if (i == length)
+		{
 			break;
+		}
 
-			default:
+		switch (CharacterClassTable[data[i++]])
+		{
+		case CHARACTER_CLASS_START:
+		{
+			RxBuffer = Inbox;
+			RxBufferSize = MAX_PACKET_SIZE;
+			RxHeaderLength = 0;
+			InboxIdx = 0;
+			InboxCrc = FRAME_CRC_SEED;
+			EscapeMode = FALSE;
+			PacketStartedFlag = TRUE;
+			TRACE(TRACE_EVENT_FRAME_START, 0, 0);
+#ifdef PACKET_MANAGER_STREAM
+			StreamCheckLength = StreamDelegate ? 1 : 0;
+#endif
+		}
+		break;
+
+		case CHARACTER_CLASS_TERMINATE:
+		{
+			if (PacketStartedFlag)
 			{
-				if (PacketStartedFlag)
+				uint16_t frame_length = RxHeaderLength + InboxIdx;
+
+				// Validate pdu; crc is kept up to date as the bytes arrive and the residue of a
+				//valid pdu, crc code included, is zero.
+				if ((frame_length >= sizeof(FrameCrc_t)) && !InboxCrc)
+				{
+					InboxParseIdx = 0;
+					STATS_ADD(rxFrames, 1);
+					TRACE(TRACE_EVENT_FRAME_END, 0, frame_length - sizeof(FrameCrc_t));
+
+					// Call event occurred delegate.
+					EventOccurredDelegate ? EventOccurredDelegate(
+												PACKET_MANAGER_PDU_RECEIVED_EVENT,
+												frame_length - sizeof(FrameCrc_t))
+										  : (void)0;
+				}
+				else
 				{
-					// Discard this packet since it exceeded the packet size.
-					if (InboxDataLength == MAX_PACKET_SIZE)
-					{
-						PacketStartedFlag = FALSE;
-					}
-
-					if (EscapeMode)
-					{
-						Inbox[InboxIdx++] = decode(data[i]);
-						EscapeMode = FALSE;
-					}
-					else
-					{
-						Inbox[InboxIdx++] = data[i];
-					}
+					STATS_ADD(rxCrcErrors, 1);
+					TRACE(TRACE_EVENT_CRC_FAIL, 0, frame_length);
 				}
+
+				PacketStartedFlag = FALSE;
 			}
+		}
+		break;
+
+		case CHARACTER_CLASS_ESCAPE:
+		{
+			EscapeMode = TRUE;
+		}
+		break;
+		}
+	}
+}
+
+#endif
+
+// Returns the index of the first special character, or length if there is none.
+static uint16_t findSpecial(uint8_t *data, uint16_t length)
+{
+	uint16_t i = 0;
+
+#if defined(__AVX2__)
+	const __m256i start_256 = _mm256_set1_epi8(START_CHARACTER);
+	const __m256i terminate_256 = _mm256_set1_epi8(TERMINATE_CHARACTER);
+	const __m256i escape_256 = _mm256_set1_epi8(ESCAPE_CHARACTER);
+
+	for (; (length - i) >= 32; i += 32)
+	{
+		__m256i block = _mm256_loadu_si256((const __m256i *)&data[i]);
+		uint32_t mask = (uint32_t)_mm256_movemask_epi8(
+			_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(block, start_256),
+											_mm256_cmpeq_epi8(block, terminate_256)),
+							_mm256_cmpeq_epi8(block, escape_256)));
+
+		if (mask)
+		{
+			return i + __builtin_ctz(mask);
+		}
+	}
+#endif
+
+#if defined(__SSE2__)
+	const __m128i start_128 = _mm_set1_epi8(START_CHARACTER);
+	const __m128i terminate_128 = _mm_set1_epi8(TERMINATE_CHARACTER);
+	const __m128i escape_128 = _mm_set1_epi8(ESCAPE_CHARACTER);
+
+	for (; (length - i) >= 16; i += 16)
+	{
+		__m128i block = _mm_loadu_si128((const __m128i *)&data[i]);
+		uint32_t mask = (uint32_t)_mm_movemask_epi8(
+			_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, start_128),
+									  _mm_cmpeq_epi8(block, terminate_128)),
+						 _mm_cmpeq_epi8(block, escape_128)));
+
+		if (mask)
+		{
+			return i + __builtin_ctz(mask);
+		}
+	}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	const uint8x16_t start_128 = vdupq_n_u8(START_CHARACTER);
+	const uint8x16_t terminate_128 = vdupq_n_u8(TERMINATE_CHARACTER);
+	const uint8x16_t escape_128 = vdupq_n_u8(ESCAPE_CHARACTER);
+
+	// Block with a special character is left to the scalar loop to locate.
+	for (; (length - i) >= 16; i += 16)
+	{
+		uint8x16_t block = vld1q_u8(&data[i]);
+		uint8x16_t match = vorrq_u8(vorrq_u8(vceqq_u8(block, start_128),
+											 vceqq_u8(block, terminate_128)),
+									vceqq_u8(block, escape_128));
+
+		if (vmaxvq_u8(match))
+		{
 			break;
-			}
 		}
 	}
-	break;
+#endif
 
-	case SERIAL_EVENT_ERROR_OCCURRED:
+	for (; i < length; i++)
 	{
-		State = PACKET_MANAGER_STATE_ERROR;
-		Serial_Stop();
+		if (CharacterClassTable[data[i]] != CHARACTER_CLASS_DATA)
+		{
+			break;
+		}
+	}
 
-		EventOccurredDelegate ? EventOccurredDelegate(PACKET_MANAGER_ERROR_OCCURRED_EVENT, 0) : (void)0;
+	return i;
+}
+
+#ifdef PACKET_MANAGER_STREAM
+// Shows the decoded header to the stream delegate; if it gives a sink, the rest of the frame is
+//decoded into it while the header stays in the inbox.
+static void checkStream(void)
+{
+	PacketManager_PduField_t sink = {0, 0};
+	uint16_t check_length = StreamDelegate(Inbox, InboxIdx, &sink);
+
+	// Delegate needs more of the header.
+	if (check_length > InboxIdx)
+	{
+		StreamCheckLength = check_length;
+		return;
 	}
-	break;
+
+	StreamCheckLength = 0;
+
+	if (sink.data && sink.length)
+	{
+		RxHeaderLength = InboxIdx;
+		RxBuffer = sink.data;
+		RxBufferSize = sink.length;
+		InboxIdx = 0;
 	}
 }
+#endif
 
+#ifndef PACKET_MANAGER_LENGTH_HEADER
 static uint8_t decode(uint8_t element)
 {
-	uint8_t __element;
+	// Unknown codes decode as terminate character.
+	if (element >= sizeof(DecodeTable))
+	{
+		return TERMINATE_CHARACTER;
+	}
+
+	return DecodeTable[element];
+}
+#endif
+
+#ifdef PACKET_MANAGER_LENGTH_HEADER
+// Copies src into dest as is, since the receiver takes the body by its length, and folds the
+//consumed bytes into crc, if given. Returns the number of source bytes consumed.
+static uint16_t encodeToBuffer(uint8_t *src, uint8_t *dest, uint16_t srcLength,
+							   uint16_t destSize, uint16_t *destLength, FrameCrc_t *crc)
+{
+	uint16_t copy_length = (destSize < srcLength) ? destSize : srcLength;
+
+	memcpy(dest, src, copy_length);
+
+	if (crc)
+	{
+		*crc = FRAME_CRC_CALCULATE(*crc, src, copy_length);
+	}
+
+	*destLength = copy_length;
+
+	return copy_length;
+}
+#else
+// Escapes src into dest until either of them is exhausted and folds the consumed bytes into
+//crc, if given. Returns the number of source bytes consumed.
+static uint16_t encodeToBuffer(uint8_t *src, uint8_t *dest, uint16_t srcLength,
+							   uint16_t destSize, uint16_t *destLength, FrameCrc_t *crc)
+{
+	uint16_t __dest_length = 0;
+	uint16_t i = 0;
+
+	while (i < srcLength)
+	{
+		uint16_t space = destSize - __dest_length;
+		uint16_t run_length = srcLength - i;
+
+		// Copy the run until the next special character at once.
+		run_length = findSpecial(&src[i], (space < run_length) ? space : run_length);
+		memcpy(&dest[__dest_length], &src[i], run_length);
+
+		if (crc)
+		{
+			*crc = FRAME_CRC_CALCULATE(*crc, &src[i], run_length);
+		}
+
+		__dest_length += run_length;
+		i += run_length;
+
+		if ((i == srcLength) || ((destSize - __dest_length) < 2) ||
+			(CharacterClassTable[src[i]] == CHARACTER_CLASS_DATA))
+		{
+			break;
+		}
+
+		if (crc)
+		{
+			*crc = FRAME_CRC_UPDATE(*crc, src[i]);
+		}
+
+		dest[__dest_length++] = ESCAPE_CHARACTER;
+		dest[__dest_length++] = EscapeCodeTable[CharacterClassTable[src[i++]]];
+
+		STATS_ADD(txEscapes, 1);
+	}
+
+	*destLength = __dest_length;
+
+	return i;
+}
+#endif
+#else
+// Continues encoding the frame until it ends or dest is full. Returns the encoded length.
+static uint16_t encodeChunk(Frame_t *frame, uint8_t *dest, uint16_t destSize)
+{
+	uint16_t dest_idx = 0;
 
-	// Decode character.
-	switch (element)
+	while ((EncoderStage != ENCODER_STAGE_DONE) && (dest_idx < destSize))
 	{
-	case ESCAPE_CHARACTER_CODE:
-		__element = ESCAPE_CHARACTER;
+		switch (EncoderStage)
+		{
+		case ENCODER_STAGE_START:
+		{
+			// Block codes look ahead up to the next zero, which may be in the crc; so it is
+			//calculated before anything is sent.
+			EncoderCrc = FRAME_CRC_SEED;
+
+			for (uint8_t i = 0; i < frame->fieldCount; i++)
+			{
+				EncoderCrc = FRAME_CRC_CALCULATE(EncoderCrc, frame->fields[i].data,
+												 frame->fields[i].length);
+			}
+
+			for (uint8_t i = 0; i < sizeof(EncoderCrcBytes); i++)
+			{
+				EncoderCrcBytes[i] = FRAME_CRC_BYTE(EncoderCrc, i);
+			}
+
+			EncoderFieldIdx = 0;
+			EncoderByteIdx = 0;
+			EncoderStage = ENCODER_STAGE_BLOCK_CODE;
+		}
 		break;
 
-	case START_CHARACTER_CODE:
-		__element = START_CHARACTER;
+		case ENCODER_STAGE_BLOCK_CODE:
+		{
+			EncoderBlockRemaining = cobsBlockLength(frame, &EncoderZeroFollows);
+			dest[dest_idx++] = EncoderBlockRemaining + 1;
+			EncoderStage = ENCODER_STAGE_FIELDS;
+		}
 		break;
 
-	case VOID_CHARACTER_CODE:
-		__element = VOID_CHARACTER;
+		case ENCODER_STAGE_FIELDS:
+		{
+			uint16_t segment_length;
+			uint8_t *segment = frameSegment(frame, EncoderFieldIdx, &segment_length);
+
+			if ((EncoderFieldIdx <= frame->fieldCount) && (EncoderByteIdx == segment_length))
+			{
+				EncoderFieldIdx++;
+				EncoderByteIdx = 0;
+				break;
+			}
+
+			if (EncoderBlockRemaining)
+			{
+				uint16_t copy_length = segment_length - EncoderByteIdx;
+
+				copy_length = (EncoderBlockRemaining < copy_length) ? EncoderBlockRemaining : copy_length;
+				copy_length = ((destSize - dest_idx) < copy_length) ? (destSize - dest_idx) : copy_length;
+
+				memcpy(&dest[dest_idx], &segment[EncoderByteIdx], copy_length);
+				dest_idx += copy_length;
+				EncoderByteIdx += copy_length;
+				EncoderBlockRemaining -= copy_length;
+				break;
+			}
+
+			// Block is done; the zero it ends with is implied by its code.
+			if (EncoderZeroFollows)
+			{
+				EncoderByteIdx++;
+				EncoderStage = ENCODER_STAGE_BLOCK_CODE;
+			}
+			else
+			{
+				EncoderStage = (EncoderFieldIdx > frame->fieldCount) ? ENCODER_STAGE_TERMINATE
+																	 : ENCODER_STAGE_BLOCK_CODE;
+			}
+		}
 		break;
 
-	default:
-	case TERMINATE_CHARACTER_CODE:
-		__element = TERMINATE_CHARACTER;
+		case ENCODER_STAGE_TERMINATE:
+		{
+			dest[dest_idx++] = COBS_DELIMITER;
+			EncoderStage = ENCODER_STAGE_DONE;
+		}
 		break;
+		}
 	}
 
-	return __element;
+	return dest_idx;
 }
 
-static void encodeToBuffer(uint8_t *src, uint8_t *dest, uint16_t srcLength,
-						   uint16_t *destLength)
+// Collects the frame up to the delimiter into inbox, then decodes and validates it at once.
+static void decodeSpan(uint8_t *data, uint16_t length)
 {
-	uint8_t element;
-	uint16_t __dest_length = 0;
+	uint16_t i = 0;
 
-	for (uint16_t i = 0; i < srcLength; i++)
+	while (i < length)
 	{
-		element = src[i];
+		uint8_t *delimiter = memchr(&data[i], COBS_DELIMITER, length - i);
+		uint16_t run_length = delimiter ? (uint16_t)(delimiter - &data[i]) : (length - i);
 
-		switch (element)
+		if (run_length && PacketStartedFlag)
 		{
-		case START_CHARACTER:
-			dest[__dest_length++] = ESCAPE_CHARACTER;
-			dest[__dest_length++] = START_CHARACTER_CODE;
-			break;
+			if (!InboxIdx)
+			{
+				TRACE(TRACE_EVENT_FRAME_START, 0, 0);
+			}
 
-		case TERMINATE_CHARACTER:
-			dest[__dest_length++] = ESCAPE_CHARACTER;
-			dest[__dest_length++] = TERMINATE_CHARACTER_CODE;
-			break;
+			// Discard this packet since it exceeded the packet size.
+			if (run_length > (MAX_PACKET_SIZE - InboxIdx))
+			{
+				PacketStartedFlag = FALSE;
+				STATS_ADD(rxOverflows, 1);
+			}
+			else
+			{
+				memcpy(&Inbox[InboxIdx], &data[i], run_length);
+				InboxIdx += run_length;
+			}
+		}
 
-		case ESCAPE_CHARACTER:
-			dest[__dest_length++] = ESCAPE_CHARACTER;
-			dest[__dest_length++] = ESCAPE_CHARACTER_CODE;
-			break;
+		i += run_length;
 
-		case VOID_CHARACTER:
-			dest[__dest_length++] = ESCAPE_CHARACTER;
-			dest[__dest_length++] = VOID_CHARACTER_CODE;
+		if (!delimiter)
+		{
 			break;
+		}
+
+		i++;
+
+		uint16_t pdu_length = InboxIdx;
+
+		// Validate pdu; the residue of a valid pdu, crc code included, is zero.
+		if (PacketStartedFlag && InboxIdx && cobsDecode(Inbox, &pdu_length) &&
+			(pdu_length >= sizeof(FrameCrc_t)) &&
+			!FRAME_CRC_CALCULATE(FRAME_CRC_SEED, Inbox, pdu_length))
+		{
+			InboxParseIdx = 0;
+			STATS_ADD(rxFrames, 1);
+			TRACE(TRACE_EVENT_FRAME_END, 0, pdu_length - sizeof(FrameCrc_t));
+
+			// Call event occurred delegate.
+			EventOccurredDelegate ? EventOccurredDelegate(
+										PACKET_MANAGER_PDU_RECEIVED_EVENT,
+										pdu_length - sizeof(FrameCrc_t))
+								  : (void)0;
+		}
+		else if (PacketStartedFlag && InboxIdx)
+		{
+			// Malformed block codes count as crc errors as well.
+			STATS_ADD(rxCrcErrors, 1);
+			TRACE(TRACE_EVENT_CRC_FAIL, 0, InboxIdx);
+		}
+
+		// Delimiter starts the next frame as well.
+		InboxIdx = 0;
+		PacketStartedFlag = TRUE;
+	}
+}
+
+// Frame is encoded as its fields followed by the crc bytes; segment at fieldCount is the crc.
+static uint8_t *frameSegment(Frame_t *frame, uint8_t idx, uint16_t *length)
+{
+	if (idx < frame->fieldCount)
+	{
+		*length = frame->fields[idx].length;
+		return frame->fields[idx].data;
+	}
+
+	*length = sizeof(EncoderCrcBytes);
+	return EncoderCrcBytes;
+}
+
+// Returns the number of non-zero bytes from the encoder position on, up to a block's capacity.
+static uint8_t cobsBlockLength(Frame_t *frame, Bool_t *zeroFollows)
+{
+	uint8_t segment_idx = EncoderFieldIdx;
+	uint16_t byte_idx = EncoderByteIdx;
+	uint16_t block_length = 0;
+
+	*zeroFollows = FALSE;
+
+	while ((segment_idx <= frame->fieldCount) && (block_length < COBS_MAX_BLOCK_LENGTH))
+	{
+		uint16_t segment_length;
+		uint8_t *segment = frameSegment(frame, segment_idx, &segment_length);
+		uint16_t scan_length = segment_length - byte_idx;
+
+		scan_length = ((COBS_MAX_BLOCK_LENGTH - block_length) < scan_length)
+						  ? (COBS_MAX_BLOCK_LENGTH - block_length)
+						  : scan_length;
 
-		default:
-			dest[__dest_length++] = element;
+		uint8_t *zero = memchr(&segment[byte_idx], 0x00, scan_length);
+
+		if (zero)
+		{
+			block_length += zero - &segment[byte_idx];
+			*zeroFollows = TRUE;
 			break;
 		}
+
+		block_length += scan_length;
+		segment_idx++;
+		byte_idx = 0;
 	}
 
-	*destLength = __dest_length;
+	return block_length;
+}
+
+// Decodes the blocks in place; decoded data never gets ahead of the encoded one. Returns FALSE
+//if a block runs past the end.
+static Bool_t cobsDecode(uint8_t *data, uint16_t *length)
+{
+	uint16_t read_idx = 0;
+	uint16_t write_idx = 0;
+
+	while (read_idx < *length)
+	{
+		uint8_t code = data[read_idx++];
+		uint8_t block_length = code - 1;
+
+		if (!code || (block_length > (*length - read_idx)))
+		{
+			return FALSE;
+		}
+
+		memmove(&data[write_idx], &data[read_idx], block_length);
+		write_idx += block_length;
+		read_idx += block_length;
+
+		// Full block has no zero after it; neither has the last one.
+		if ((code != (COBS_MAX_BLOCK_LENGTH + 1)) && (read_idx < *length))
+		{
+			data[write_idx++] = 0x00;
+		}
+	}
+
+	*length = write_idx;
+
+	return TRUE;
+}
+#endif
+
+// Drops any partial frame. Escaped frames are collected from a start character on; a COBS
+//frame begins right after the previous delimiter.
+static void resetDecoder(void)
+{
+	RxBuffer = Inbox;
+	RxBufferSize = MAX_PACKET_SIZE;
+	RxHeaderLength = 0;
+	InboxIdx = 0;
+
+#if defined(PACKET_MANAGER_COBS)
+	PacketStartedFlag = TRUE;
+#elif defined(PACKET_MANAGER_LENGTH_HEADER)
+	DecoderStage = DECODER_STAGE_HUNT;
+#else
+	EscapeMode = FALSE;
+	PacketStartedFlag = FALSE;
+#endif
 }
@@ -1,14 +1,35 @@
 #include "stm32f4xx_hal.h"
 #include "serial.h"
+#include "trace.h"
 
 #define RING_BUFFER_MASK (SERIAL_RING_BUFFER_SIZE - 1)
 #define HALF_BUFFER_SIZE (SERIAL_RING_BUFFER_SIZE >> 1)
 #define MID_ELEMENT (HALF_BUFFER_SIZE - 1)
 
+// Bumps a line counter; the generation tells a snapshot in progress to copy again.
+#ifdef SERIAL_STATS
+#define STATS_ADD(counter, value) \
+	do                            \
+	{                             \
+		Stats.counter += (value); \
+		StatsGeneration++;        \
+	} while (0)
+#else
+#define STATS_ADD(counter, value) ((void)0)
+#endif
+
+/* Private function prototypes ---------------------------------------------*/
+static uint32_t getWriteCount(void);
+static void notifyDataReady(uint16_t size);
+static Bool_t transmitNext(void);
+
 /* Private variables -------------------------------------------------------*/
-// Receive buffer.
+// Receive buffer. Halves completed by the DMA are counted in its interrupts, so that a ring
+//filled completely between two executes is told from an empty one. Counts run free.
 static uint8_t Buffer[SERIAL_RING_BUFFER_SIZE];
 static volatile uint16_t BufferReadIdx;
+static volatile uint32_t RxHalfCount;
+static uint32_t BufferReadCount;
 
 // Flags.
 static volatile Bool_t TxIdle;
@@ -17,20 +38,24 @@ static volatile Bool_t RestartReceive;
 
 // Delegates.
 static Serial_EventOccurredDelegate_t EventOccurredDelegate;
+static Serial_TxDataRequestDelegate_t TxDataRequestDelegate;
+
+#ifdef SERIAL_STATS
+// Errors and transmitted bytes are counted in the interrupts, the rest in the main loop.
+static volatile Serial_Stats_t Stats;
+static volatile uint32_t StatsGeneration;
+#endif
 
 /* Exported variables ------------------------------------------------------*/
 extern UART_HandleTypeDef SERIAL_UART_HANDLE;
 
-void Serial_Setup(Serial_EventOccurredDelegate_t eventHandler) {
+void Serial_Setup(Serial_EventOccurredDelegate_t eventHandler,
+		Serial_TxDataRequestDelegate_t txDataRequestHandler) {
 	EventOccurredDelegate = eventHandler;
+	TxDataRequestDelegate = txDataRequestHandler;
 }
 
 Bool_t Serial_Start(void) {
-	// Fill the buffer with flag character.
-	for (uint16_t i = 0; i < SERIAL_RING_BUFFER_SIZE; i++) {
-		Buffer[i] = SERIAL_VOID_CHARACTER;
-	}
-
 	// Initialize flags.
 	TxIdle = TRUE;
 	TxCompleted = FALSE;
@@ -38,6 +63,8 @@ Bool_t Serial_Start(void) {
 
 	// Initialize buffer.
 	BufferReadIdx = 0;
+	BufferReadCount = 0;
+	RxHalfCount = 0;
 
 	// Start receiving in circular manner.
 	if (HAL_UART_Receive_DMA(&SERIAL_UART_HANDLE, Buffer, sizeof(Buffer)) != HAL_OK) {
@@ -48,49 +75,44 @@ Bool_t Serial_Start(void) {
 }
 
 void Serial_Execute(void) {
-	uint16_t size = 0;
-	uint16_t __pos;
-	__pos = BufferReadIdx;
-
-	// DMA had written until the void character.
-	while (Buffer[__pos] != SERIAL_VOID_CHARACTER) {
-		__pos++;
-		__pos &= RING_BUFFER_MASK;
-
-		if (++size >= SERIAL_RING_BUFFER_SIZE) {
-			break;
-		}
-	}
-
-	// If there are any element in the buffer, call the delegate function.
-	if (size) {
-		EventOccurredDelegate ?
-				EventOccurredDelegate(SERIAL_EVENT_DATA_READY,
-						&Buffer[BufferReadIdx], size) :
-				(void) 0;
-
-		// Clear transferred items.
-		for (uint16_t i = 0; i < size; i++) {
-			Buffer[BufferReadIdx++] = SERIAL_VOID_CHARACTER;
-			BufferReadIdx &= RING_BUFFER_MASK;
-		}
-	}
-
-	if (TxIdle) {
-		EventOccurredDelegate ?
-				EventOccurredDelegate(SERIAL_EVENT_TX_IDLE, 0, 0xFFFF) :
-				(void) 0;
+	uint32_t __write_count;
+	uint32_t size;
+
+	// Bytes written by the DMA and not yet taken; up to the whole ring.
+	__write_count = getWriteCount();
+	size = __write_count - BufferReadCount;
+
+	// DMA lapped the ring since the last execute and overwrote data not yet taken. Drop all of
+	//it; the packet manager syncs again on the next frame.
+	if (size > SERIAL_RING_BUFFER_SIZE) {
+		BufferReadCount = __write_count;
+		BufferReadIdx = __write_count & RING_BUFFER_MASK;
+		size = 0;
+		STATS_ADD(errors, 1);
 	}
 
+	// Transmission ended before anything received with it could be answered; report it first.
 	if (TxCompleted)
 	{
-		EventOccurredDelegate ? EventOccurredDelegate(SERIAL_EVENT_TX_COMPLETED, 0, 0xFFFF) : (void)0;
+		EventOccurredDelegate ? EventOccurredDelegate(SERIAL_EVENT_TX_COMPLETED, 0, 0) : (void)0;
 		TxCompleted = FALSE;
 	}
 
+	// If there are any element in the buffer, call the delegate function.
+	if (size) {
+		STATS_ADD(rxBytes, size);
+		TRACE(TRACE_EVENT_RX_DATA, 0, size);
+		notifyDataReady(size);
+		BufferReadCount += size;
+	}
+
 	// If some error occurred; restart receive.
 	if (RestartReceive) {
 		RestartReceive = FALSE;
+		BufferReadIdx = 0;
+		BufferReadCount = 0;
+		RxHalfCount = 0;
+		STATS_ADD(restarts, 1);
 
 		// Start receiving in circular manner.
 		if (HAL_UART_Receive_DMA(&SERIAL_UART_HANDLE, Buffer, sizeof(Buffer)) != HAL_OK) {
@@ -107,24 +129,121 @@ void Serial_Stop(void) {
 	}
 }
 
-void Serial_Send(uint8_t *data, uint16_t dataLength) {
-	TxIdle = FALSE;
-
-	if (HAL_UART_Transmit_DMA(&SERIAL_UART_HANDLE, data, dataLength) != HAL_OK) {
-		while (1)
-			;
+void Serial_Transmit(void) {
+	// A transfer is in progress; its complete interrupt picks up the data.
+	if (!TxIdle) {
+		return;
 	}
+
+	transmitNext();
 }
 
+#ifdef SERIAL_STATS
+void Serial_GetStats(Serial_Stats_t *stats) {
+	uint32_t generation;
+
+	do {
+		generation = StatsGeneration;
+		*stats = Stats;
+	} while (generation != StatsGeneration);
+}
+#endif
+
 void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart) {
 	if (huart == &SERIAL_UART_HANDLE) {
-		TxCompleted = TRUE;
 		TxIdle = TRUE;
+
+		// Chain the next transfer directly; transmission is completed if there is none.
+		if (!transmitNext()) {
+			TxCompleted = TRUE;
+			TRACE(TRACE_EVENT_TX_DONE, 0, 0);
+		}
+	}
+}
+
+void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *huart) {
+	if (huart == &SERIAL_UART_HANDLE) {
+		RxHalfCount++;
+	}
+}
+
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart) {
+	if (huart == &SERIAL_UART_HANDLE) {
+		RxHalfCount++;
 	}
 }
 
 void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart) {
 	if (huart == &SERIAL_UART_HANDLE) {
 		RestartReceive = TRUE;
+		STATS_ADD(errors, 1);
 	}
+}
+
+/* Private functions -------------------------------------------------------*/
+// Bytes written by the DMA since reception started. The remaining-count register gives the
+//position in the current half; a half completed but whose interrupt is not served yet is added
+//here. Holds as long as the interrupt is served within half a ring's time.
+static uint32_t getWriteCount(void) {
+	uint32_t half_count;
+	uint16_t write_idx;
+
+	do {
+		half_count = RxHalfCount;
+		write_idx = (SERIAL_RING_BUFFER_SIZE
+				- __HAL_DMA_GET_COUNTER(SERIAL_UART_HANDLE.hdmarx)) & RING_BUFFER_MASK;
+	} while (half_count != RxHalfCount);
+
+	if ((write_idx >= HALF_BUFFER_SIZE) != (half_count & 1)) {
+		half_count++;
+	}
+
+	return (half_count * HALF_BUFFER_SIZE) + (write_idx & MID_ELEMENT);
+}
+
+static void notifyDataReady(uint16_t size) {
+	Serial_Span_t spans[2];
+	uint8_t span_count = 1;
+	uint16_t tail_size = SERIAL_RING_BUFFER_SIZE - BufferReadIdx;
+
+	spans[0].data = &Buffer[BufferReadIdx];
+
+	if (size <= tail_size) {
+		spans[0].length = size;
+	} else {
+		// Data wraps around; the rest starts at the beginning of the ring. A full ring ends
+		//where it starts.
+		spans[0].length = tail_size;
+		spans[1].data = Buffer;
+		spans[1].length = size - tail_size;
+		span_count++;
+	}
+
+	EventOccurredDelegate ?
+			EventOccurredDelegate(SERIAL_EVENT_DATA_READY, spans, span_count) :
+			(void) 0;
+
+	BufferReadIdx = (BufferReadIdx + size) & RING_BUFFER_MASK;
+}
+
+static Bool_t transmitNext(void) {
+	Serial_Span_t span;
+	span.data = 0;
+	span.length = 0;
+
+	TxDataRequestDelegate ? TxDataRequestDelegate(&span) : (void) 0;
+
+	if (!span.length) {
+		return FALSE;
+	}
+
+	TxIdle = FALSE;
+	STATS_ADD(txBytes, span.length);
+
+	if (HAL_UART_Transmit_DMA(&SERIAL_UART_HANDLE, span.data, span.length) != HAL_OK) {
+		while (1)
+			;
+	}
+
+	return TRUE;
 }
\ No newline at end of file
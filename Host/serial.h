@@ -2,7 +2,9 @@
 #define __SERIAL_H
 
 #include "generic.h"
+#ifndef SERIAL_POSIX
 #include "stm32f4xx_hal.h"
+#endif
 
 #ifdef __cplusplus
 extern "C"
@@ -10,10 +12,18 @@ extern "C"
 #endif
 
 /* Exported definitions ----------------------------------------------------*/
-#define SERIAL_VOID_CHARACTER 0xAA
 #define SERIAL_UART_HANDLE huart1
 #define SERIAL_RING_BUFFER_SIZE (1U << 6)
 
+// Line counters, read with Serial_GetStats; compiled out unless defined.
+//#define SERIAL_STATS
+
+#ifdef SERIAL_POSIX
+#define SERIAL_POSIX_DEFAULT_DEVICE "/dev/ttyUSB0"
+#define SERIAL_POSIX_PTY_MASTER "/dev/ptmx"
+#define SERIAL_POSIX_BAUDRATE B115200
+#endif
+
 	/* Exported typedefs -------------------------------------------------------*/
 	enum
 	{
@@ -27,21 +37,80 @@ extern "C"
 	enum
 	{
 		SERIAL_EVENT_DATA_READY = 0,
-		SERIAL_EVENT_TX_IDLE,
-		SERIAL_EVENT_TX_COMPLETED, 
+		SERIAL_EVENT_TX_COMPLETED,
 		SERIAL_EVENT_ERROR_OCCURRED
 	};
 	typedef uint8_t Serial_Event_t;
 
-	typedef void (*Serial_EventOccurredDelegate_t)(Serial_Event_t event, uint8_t *data,
-												   uint16_t length);
+	// Contiguous part of the receive ring.
+	typedef struct
+	{
+		uint8_t *data;
+		uint16_t length;
+	} Serial_Span_t;
+
+	// Free running line counters; they wrap around.
+	typedef struct
+	{
+		uint32_t rxBytes;
+		uint32_t txBytes;
+		uint32_t errors;   // Errors reported by the uart or the port, and ring overruns.
+		uint32_t restarts; // Reception restarts after an error.
+	} Serial_Stats_t;
+
+	// Data ready event carries up to two spans; the second one exists when the received data
+	//wraps around the end of the ring.
+	typedef void (*Serial_EventOccurredDelegate_t)(Serial_Event_t event, Serial_Span_t *spans,
+												   uint8_t spanCount);
+
+	// Asks for the next chunk to transmit; leaving the span empty ends the transmission. Called
+	//from the transfer complete interrupt, so that successive chunks leave without a gap.
+	typedef void (*Serial_TxDataRequestDelegate_t)(Serial_Span_t *span);
 
 	/* Exported functions ------------------------------------------------------*/
-	extern void Serial_Setup(Serial_EventOccurredDelegate_t eventHandler);
+	extern void Serial_Setup(Serial_EventOccurredDelegate_t eventHandler,
+							 Serial_TxDataRequestDelegate_t txDataRequestHandler);
 	extern Bool_t Serial_Start(void);
 	extern void Serial_Execute(void);
 	extern void Serial_Stop(void);
-	extern void Serial_Send(uint8_t *data, uint16_t dataLength);
+	extern void Serial_Transmit(void);
+
+#ifdef SERIAL_STATS
+	/***
+	 * @Brief      Copies the line counters, consistent with the ones updated from the
+	 *             interrupts; call from the main loop.
+	 *
+	 * @Params     stats-> Snapshot to be filled.
+	 */
+	extern void Serial_GetStats(Serial_Stats_t *stats);
+#endif
+
+#ifdef SERIAL_POSIX
+	/***
+	 * @Brief      Selects the tty to be opened by Serial_Start. Passing SERIAL_POSIX_PTY_MASTER
+	 *             allocates a new pseudo-terminal pair and opens its master side.
+	 *
+	 * @Params     path-> Device path.
+	 */
+	extern void Serial_SetDevice(const char *path);
+
+	/***
+	 * @Brief      Returns the slave device path of the allocated pseudo-terminal.
+	 *
+	 * @Return     Slave path or 0 if the opened device is not a pseudo-terminal master.
+	 */
+	extern const char *Serial_GetPtyName(void);
+
+#ifdef SERIAL_TEST
+	/***
+	 * @Brief      Fills the receive ring completely from every start position and checks the
+	 *             data ready spans; reads a pipe in place of the port.
+	 *
+	 * @Return     TRUE if every byte is given once and in order.
+	 */
+	extern Bool_t Serial_Test(void);
+#endif
+#endif
 
 #ifdef __cplusplus
 }
@@ -9,6 +9,9 @@ extern "C" {
 
 extern uint32_t SysTime_GetTimeInMs(void);
 
+// Free running microsecond time; wraps around in about 71 minutes.
+extern uint32_t SysTime_GetTimeInUs(void);
+
 #ifdef __cplusplus
 }
 #endif
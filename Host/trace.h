@@ -0,0 +1,84 @@
+#ifndef __TRACE_H
+#define __TRACE_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "generic.h"
+
+/* Exported definitions ----------------------------------------------------*/
+// Trace points record into the ring only when defined; otherwise they compile to nothing.
+//#define TRACE_ENABLE
+
+// Number of records kept; a power of two. Oldest records are overwritten.
+#ifndef TRACE_RING_LENGTH
+#define TRACE_RING_LENGTH 256
+#endif
+
+#define TRACE_DUMP_MAGIC 0x45435254UL
+
+#ifdef TRACE_ENABLE
+#define TRACE(event, arg8, arg16) Trace_Record((event), (uint8_t)(arg8), (uint16_t)(arg16))
+#else
+#define TRACE(event, arg8, arg16) ((void)0)
+#endif
+
+	/* Exported typedefs -------------------------------------------------------*/
+	// Arguments of each event are given next to it.
+	enum
+	{
+		TRACE_EVENT_RX_DATA = 0x00,	   // -, received byte count
+		TRACE_EVENT_TX_DONE,		   // -, -
+		TRACE_EVENT_FRAME_START,	   // direction (0 rx, 1 tx), -
+		TRACE_EVENT_FRAME_END,		   // direction (0 rx, 1 tx), pdu size if rx
+		TRACE_EVENT_CRC_FAIL,		   // -, frame size
+		TRACE_EVENT_DIRECTION_SWITCH,  // objshare protocol direction, -
+		TRACE_EVENT_REQUEST_ENQUEUE,   // slot, process code << 8 | object id
+		TRACE_EVENT_REQUEST_DEQUEUE,   // slot, process code << 8 | object id
+		TRACE_EVENT_REQUEST_RESPONSE,  // slot, pdu type << 8 | operation result
+		TRACE_EVENT_REQUEST_TIMEOUT,   // slot, successive request count
+		TRACE_EVENT_COUNT
+	};
+	typedef uint8_t Trace_Event_t;
+
+	typedef struct
+	{
+		uint32_t timestamp; // Microseconds.
+		uint8_t event;
+		uint8_t arg8;
+		uint16_t arg16;
+	} Trace_Record_t;
+
+	// Dump of the ring is this header followed by the ring as is; record of index i is at
+	//i % length, and the last head records, length at most, are valid.
+	typedef struct
+	{
+		uint32_t magic;
+		uint32_t head;
+		uint32_t length;
+	} Trace_DumpHeader_t;
+
+	/* Exported functions ------------------------------------------------------*/
+#ifdef TRACE_ENABLE
+	/***
+	 * @Brief      Appends a record; safe to call from interrupts and the main loop alike.
+	 */
+	extern void Trace_Record(Trace_Event_t event, uint8_t arg8, uint16_t arg16);
+#endif
+
+	/***
+	 * @Brief      Gives the ring to be dumped.
+	 *
+	 * @Params     header-> Header to be filled for the dump.
+	 *
+	 * @Return     Ring of header->length records; none unless built with TRACE_ENABLE.
+	 */
+	extern const Trace_Record_t *Trace_GetRing(Trace_DumpHeader_t *header);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -8,9 +8,85 @@ extern "C"
 
 #include "generic.h"
 
+// Hardware CRC32C instructions.
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+// CRC16 engines. Table engines trade flash (and RAM for the slice tables, which are derived
+//from the base table on first use) for fewer operations per byte.
+#define CRC_ENGINE_BITWISE 0
+#define CRC_ENGINE_TABLE 1
+#define CRC_ENGINE_SLICE_BY_4 2
+#define CRC_ENGINE_SLICE_BY_8 3
+
+// Engine used by CRC_Calculate16; the engines below it are available as well. Cortex-M0 keeps
+//the bitwise one, 64 bit hosts slice by 8 bytes.
+#ifndef CRC_ENGINE
+#if defined(__x86_64__) || defined(__aarch64__)
+#define CRC_ENGINE CRC_ENGINE_SLICE_BY_8
+#elif defined(__ARM_ARCH_6M__)
+#define CRC_ENGINE CRC_ENGINE_BITWISE
+#else
+#define CRC_ENGINE CRC_ENGINE_TABLE
+#endif
+#endif
+
+#define CRC32C_POLY 0x82F63B78UL
+
+	/* Exported variables --------------------------------------------------------*/
+#if (CRC_ENGINE != CRC_ENGINE_BITWISE)
+	extern const uint16_t CRC_Table16[256];
+#endif
+
 	/* Exported functions --------------------------------------------------------*/
 	/***
-  * @brief      Calculates CRC16 code of the given byte array.
+  * @brief      Updates CCITT CRC16 code with a single byte.
+  *
+  * @params     crc-> Current crc value.
+  * 			data-> Byte to be added.
+  *
+  * @retval     CRC code.
+  */
+	static inline uint16_t CRC_Update16(uint16_t crc, uint8_t data)
+	{
+#if (CRC_ENGINE != CRC_ENGINE_BITWISE)
+		return (crc << 8) ^ CRC_Table16[(uint8_t)(crc >> 8) ^ data];
+#else
+		uint8_t x = crc >> 8 ^ data;
+		x ^= x >> 4;
+
+		return (crc << 8) ^ ((uint16_t)(x << 12)) ^ ((uint16_t)(x << 5)) ^ ((uint16_t)x);
+#endif
+	}
+
+	/***
+  * @brief      Updates CRC32C code with a single byte.
+  *
+  * @params     crc-> Current crc value.
+  * 			data-> Byte to be added.
+  *
+  * @retval     CRC code.
+  */
+	static inline uint32_t CRC_Update32C(uint32_t crc, uint8_t data)
+	{
+#if defined(__SSE4_2__)
+		return _mm_crc32_u8(crc, data);
+#else
+		crc ^= data;
+
+		for (uint8_t i = 0; i < 8; i++)
+		{
+			crc = (crc >> 1) ^ (CRC32C_POLY & (0UL - (crc & 0x01)));
+		}
+
+		return crc;
+#endif
+	}
+
+	/***
+  * @brief      Calculates CCITT CRC16 code of the given byte array with the configured engine.
   *
   * @params     seed-> Initial crc value.
   * 			buff-> Pointer to buffer.
@@ -20,6 +96,30 @@ extern "C"
   */
 	extern uint16_t CRC_Calculate16(uint16_t seed, uint8_t *buff, uint16_t size);
 
+	// Engines, same parameters and result as CRC_Calculate16.
+	extern uint16_t CRC_Calculate16Bitwise(uint16_t seed, uint8_t *buff, uint16_t size);
+#if (CRC_ENGINE >= CRC_ENGINE_TABLE)
+	extern uint16_t CRC_Calculate16Table(uint16_t seed, uint8_t *buff, uint16_t size);
+#endif
+#if (CRC_ENGINE >= CRC_ENGINE_SLICE_BY_4)
+	extern uint16_t CRC_Calculate16SliceBy4(uint16_t seed, uint8_t *buff, uint16_t size);
+#endif
+#if (CRC_ENGINE >= CRC_ENGINE_SLICE_BY_8)
+	extern uint16_t CRC_Calculate16SliceBy8(uint16_t seed, uint8_t *buff, uint16_t size);
+#endif
+
+	/***
+  * @brief      Calculates CRC32C (Castagnoli, reflected) code of the given byte array. Uses the
+  *             SSE4.2 crc32 instruction when the target has it. No final xor is applied.
+  *
+  * @params     seed-> Initial crc value.
+  * 			buff-> Pointer to buffer.
+  *             size-> Size of the buffer.
+  *
+  * @retval     CRC code.
+  */
+	extern uint32_t CRC_Calculate32C(uint32_t seed, uint8_t *buff, uint16_t size);
+
 	/***
   * @brief      Calculates CRC8 code of the given byte array.
   *
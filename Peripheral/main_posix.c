@@ -0,0 +1,119 @@
+/* Includes ------------------------------------------------------------------*/
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "objshare_peripheral.h"
+#include "peripheral.h"
+#include "packet_manager.h"
+#include "serial.h"
+#include "sys_time.h"
+
+/* Private variables ---------------------------------------------------------*/
+// Objects served to the host.
+static char Name[PRP_MAX_NAME_LENGTH] = "posix";
+static Prp_Properties_t Properties;
+static float TargetValue;
+static float CurrentValue;
+static uint8_t State;
+static uint8_t ErrorCode;
+static float PidICoeff;
+static float PidKCoeff;
+static float PidDCoeff;
+static float CalibrationTable[PRP_CALIBRATION_TABLE_LENGTH];
+#ifdef PACKET_MANAGER_STREAM
+// Calibration table is written in fragments larger than a shrunk inbox.
+static uint8_t CalibrationTableShadow[OBJSHARE_PERIPHERAL_SHADOW_SIZE(sizeof(CalibrationTable))];
+#endif
+
+/* Public function implementations. ------------------------------------------*/
+// Serves the slot objects over the given tty until terminated.
+int main(int argc, char **argv)
+{
+	const char *device = SERIAL_POSIX_DEFAULT_DEVICE;
+	int opt;
+
+#ifdef SERIAL_TEST
+	if (!Serial_Test())
+	{
+		fprintf(stderr, "serial test failed\n");
+		return EXIT_FAILURE;
+	}
+	printf("serial test passed\n");
+#endif
+
+#ifdef PACKET_MANAGER_TEST
+	if (!PacketManager_Test())
+	{
+		fprintf(stderr, "packet manager test failed\n");
+		return EXIT_FAILURE;
+	}
+	printf("packet manager test passed\n");
+#endif
+
+#if defined(SERIAL_TEST) || defined(PACKET_MANAGER_TEST)
+	return EXIT_SUCCESS;
+#endif
+
+	while ((opt = getopt(argc, argv, "d:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'd':
+			device = optarg;
+			break;
+
+		default:
+			fprintf(stderr, "usage: %s [-d device]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	Serial_SetDevice(device);
+	ObjsharePeripheral_Setup(0, 0, 0);
+
+	ObjsharePeripheral_Register(PRP_NAME_OBJ_ID, Name, sizeof(Name),
+								OBJSHARE_PERIPHERAL_OBJ_PROPERTY_READ);
+	ObjsharePeripheral_Register(PRP_PROPERTIES_OBJ_ID, &Properties, sizeof(Properties),
+								OBJSHARE_PERIPHERAL_OBJ_PROPERTY_READ);
+	ObjsharePeripheral_Register(PRP_TARGET_VALUE_OBJ_ID, &TargetValue, sizeof(TargetValue),
+								OBJSHARE_PERIPHERAL_OBJ_PROPERTY_READ | OBJSHARE_PERIPHERAL_OBJ_PROPERTY_WRITE);
+	ObjsharePeripheral_Register(PRP_CURRENT_VALUE_OBJ_ID, &CurrentValue, sizeof(CurrentValue),
+								OBJSHARE_PERIPHERAL_OBJ_PROPERTY_READ);
+	ObjsharePeripheral_Register(PRP_STATE_OBJ_ID, &State, sizeof(State),
+								OBJSHARE_PERIPHERAL_OBJ_PROPERTY_READ);
+	ObjsharePeripheral_Register(PRP_ERROR_CODE_OBJ_ID, &ErrorCode, sizeof(ErrorCode),
+								OBJSHARE_PERIPHERAL_OBJ_PROPERTY_READ);
+	ObjsharePeripheral_Register(PRP_PID_I_COEFF_OBJ_ID, &PidICoeff, sizeof(PidICoeff),
+								OBJSHARE_PERIPHERAL_OBJ_PROPERTY_READ | OBJSHARE_PERIPHERAL_OBJ_PROPERTY_WRITE);
+	ObjsharePeripheral_Register(PRP_PID_K_COEFF_OBJ_ID, &PidKCoeff, sizeof(PidKCoeff),
+								OBJSHARE_PERIPHERAL_OBJ_PROPERTY_READ | OBJSHARE_PERIPHERAL_OBJ_PROPERTY_WRITE);
+	ObjsharePeripheral_Register(PRP_PID_D_COEFF_OBJ_ID, &PidDCoeff, sizeof(PidDCoeff),
+								OBJSHARE_PERIPHERAL_OBJ_PROPERTY_READ | OBJSHARE_PERIPHERAL_OBJ_PROPERTY_WRITE);
+	ObjsharePeripheral_Register(PRP_CALIBRATION_TABLE_OBJ_ID, CalibrationTable, sizeof(CalibrationTable),
+								OBJSHARE_PERIPHERAL_OBJ_PROPERTY_READ | OBJSHARE_PERIPHERAL_OBJ_PROPERTY_WRITE);
+#ifdef PACKET_MANAGER_STREAM
+	ObjsharePeripheral_SetShadow(PRP_CALIBRATION_TABLE_OBJ_ID, CalibrationTableShadow);
+#endif
+
+	ObjsharePeripheral_Start();
+
+	uint32_t sys_time = SysTime_GetTimeInMs();
+
+	while (TRUE)
+	{
+		// Current value closes a tenth of its gap to the target value every ms, as a heater would.
+		if (SysTime_GetTimeInMs() != sys_time)
+		{
+			float last_value = CurrentValue;
+
+			sys_time = SysTime_GetTimeInMs();
+			CurrentValue += (TargetValue - CurrentValue) * 0.1f;
+
+			(CurrentValue != last_value) ? ObjsharePeripheral_Touch(PRP_CURRENT_VALUE_OBJ_ID) : (void)0;
+		}
+
+		ObjsharePeripheral_Execute();
+		sched_yield();
+	}
+}
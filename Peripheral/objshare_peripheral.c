@@ -1,12 +1,52 @@
+#include <string.h>
+#include "packet_manager.h"
 #include "objshare_peripheral.h"
+#include "sys_time.h"
 
 /* Private typedefs ----------------------------------------------------------*/
+// Object the host is subscribed to. Notification holds the slot and object id of the
+//subscription, then the value last notified; changes are measured from it.
+typedef struct
+{
+	Bool_t isActive;
+	Bool_t isPending;
+	uint16_t minInterval;
+	float deadband;
+	uint32_t timestamp;
+	uint8_t notification[OBJSHARE_PROTOCOL_NOTIFY_HEADER_SIZE + OBJSHARE_PERIPHERAL_MAX_SUBSCRIPTION_SIZE];
+} Subscription_t;
+
+// Value of the object last sent in a read delta response, and the number it was sent with; 0
+//when there is none.
+typedef struct
+{
+	uint8_t objId;
+	uint16_t number;
+	uint8_t value[OBJSHARE_PERIPHERAL_MAX_DELTA_SIZE];
+} DeltaBaseline_t;
+
 /* Private function declarations ---------------------------------------------*/
 static void pduReceivedEventHandler(ObjshareProtocol_PduType_t pduType,
 									uint8_t objId, uint16_t unparsedPduSize);
 
 static ObjsharePeripheral_Object_t *getObj(uint8_t objId);
+static void touch(ObjsharePeripheral_Object_t *object);
 static uint8_t getObjIdx(uint8_t objId);
+static uint16_t readMulti(uint8_t *objIds, uint8_t count);
+static Bool_t writeMulti(uint8_t *data, uint16_t length, uint8_t count, uint8_t *results);
+static Bool_t isInRange(ObjsharePeripheral_Object_t *object, uint16_t offset, uint16_t length);
+static uint16_t getChanges(uint16_t sequence);
+static uint16_t readDelta(ObjsharePeripheral_Object_t *object, uint16_t baselineNumber);
+static DeltaBaseline_t *getDeltaBaseline(ObjsharePeripheral_Object_t *object);
+static Bool_t encodeDelta(uint8_t *baseline, uint8_t *value, uint16_t length, uint8_t *delta,
+						  uint16_t *deltaLength);
+static Bool_t subscribe(uint8_t objId, uint8_t *parameters, uint16_t length);
+static Subscription_t *getSubscription(uint8_t objId);
+static void notifySubscribers(void);
+static Bool_t isChanged(Subscription_t *subscription, ObjsharePeripheral_Object_t *object);
+#ifdef PACKET_MANAGER_STREAM
+static uint8_t *pduDataSinkEventHandler(uint8_t objId, uint16_t offset, uint16_t *capacity);
+#endif
 
 /* Private variables ---------------------------------------------------------*/
 // Variables to store module control data.
@@ -22,12 +62,37 @@ static uint8_t NumOfObjects;
 static ObjsharePeripheral_EventOccurredDelegate_t EventOccurredDelegate;
 static ObjsharePeripheral_IsAddressedDelegate_t IsAddressedDelegate;
 
+// Response of a read multi, read delta, read if changed or get changes request being sent, or a
+//fragmented write multi or write range request being received.
+static uint8_t MultiBuffer[OBJSHARE_PROTOCOL_MAX_MULTI_DATA_SIZE];
+
+// Subscriptions of the host.
+static Subscription_t Subscriptions[OBJSHARE_PERIPHERAL_MAX_SUBSCRIPTION_COUNT];
+
+// Set by a broadcast write, which addresses every peripheral at once; notifications wait for the
+//next request to this peripheral alone.
+static Bool_t IsBroadcastAddressed;
+
+// Values sent in read delta responses; taken in turn.
+static DeltaBaseline_t DeltaBaselines[OBJSHARE_PERIPHERAL_MAX_DELTA_COUNT];
+static uint8_t NextDeltaBaselineIdx;
+static uint16_t NextDeltaBaselineNumber;
+
+// Ids of the objects changed last, each at the sequence number of its change. Journal holds the
+//changes from JournalSequence - JournalCount until JournalSequence, the number of the next one.
+static uint8_t Journal[OBJSHARE_PERIPHERAL_JOURNAL_LENGTH];
+static uint16_t JournalSequence;
+static uint8_t JournalCount;
+
 /* Public function implementations. ------------------------------------------*/
 void ObjsharePeripheral_Setup(ObjsharePeripheral_EventOccurredDelegate_t eventHandler,
 							  ObjsharePeripheral_IsAddressedDelegate_t isAddressedEventHandler,
 							  ObjshareProtocol_SwitchDirectionDelegate_t switchedEventHandler)
 {
 	ObjshareProtocol_Setup(&pduReceivedEventHandler, switchedEventHandler);
+#ifdef PACKET_MANAGER_STREAM
+	ObjshareProtocol_SetPduDataSinkDelegate(&pduDataSinkEventHandler);
+#endif
 
 	// Set delegates.
 	EventOccurredDelegate = eventHandler;
@@ -35,6 +100,10 @@ void ObjsharePeripheral_Setup(ObjsharePeripheral_EventOccurredDelegate_t eventHa
 
 	// Set parameters.
 	NumOfObjects = 0;
+	memset(Subscriptions, 0, sizeof(Subscriptions));
+	memset(DeltaBaselines, 0, sizeof(DeltaBaselines));
+	JournalSequence = 1;
+	JournalCount = 0;
 
 	// Set state to ready.
 	State = OBJSHARE_PERIPHERAL_STATE_READY;
@@ -45,6 +114,10 @@ void ObjsharePeripheral_Register(uint8_t objId, void *obj, uint16_t objSize, uin
 	ObjectTable[NumOfObjects].objId = objId;
 	ObjectTable[NumOfObjects].data = (uint8_t *)obj;
 	ObjectTable[NumOfObjects].length = objSize;
+	ObjectTable[NumOfObjects].version = 1;
+#ifdef PACKET_MANAGER_STREAM
+	ObjectTable[NumOfObjects].shadow = 0;
+#endif
 	ObjectTable[NumOfObjects++].properties = properties;
 }
 
@@ -64,6 +137,18 @@ void ObjsharePeripheral_DeRegister(uint8_t objId)
 	}
 }
 
+#ifdef PACKET_MANAGER_STREAM
+void ObjsharePeripheral_SetShadow(uint8_t objId, uint8_t *shadow)
+{
+	ObjsharePeripheral_Object_t *object = getObj(objId);
+
+	if (object)
+	{
+		object->shadow = shadow;
+	}
+}
+#endif
+
 void ObjsharePeripheral_Start(void)
 {
 	// Start object protocol.
@@ -82,6 +167,8 @@ void ObjsharePeripheral_Execute(void)
 
 	// Call submodule's executer.
 	ObjshareProtocol_Execute();
+
+	notifySubscribers();
 }
 
 void ObjsharePeripheral_Stop(void)
@@ -93,6 +180,13 @@ void ObjsharePeripheral_Stop(void)
 	State = OBJSHARE_PERIPHERAL_STATE_READY;
 }
 
+void ObjsharePeripheral_Touch(uint8_t objId)
+{
+	ObjsharePeripheral_Object_t *object = getObj(objId);
+
+	object ? touch(object) : (void)0;
+}
+
 ObjsharePeripheral_Object_t *ObjsharePeripheral_ParseObject(uint8_t objId)
 {
 	return &ObjectTable[getObjIdx(objId)];
@@ -116,22 +210,29 @@ static void pduReceivedEventHandler(ObjshareProtocol_PduType_t pduType,
 		return;
 	}
 
+	IsBroadcastAddressed = (pduType == OBJSHARE_PROTOCOL_PDUTYPE_WRITE_BROADCAST_REQ);
+
 	switch (pduType)
 	{
 	case OBJSHARE_PROTOCOL_PDUTYPE_READ_REQ:
 	{
 		ObjsharePeripheral_Object_t *object = getObj(objId);
+		uint8_t *parameters;
+		uint16_t length = ObjshareProtocol_ViewPduData(&parameters, unparsedPduSize);
 
-		// If the object is readable; read and send it.
-		if (object && (object->properties & OBJSHARE_PERIPHERAL_OBJ_PROPERTY_READ))
+		// If the object is readable; read and send it, no longer than the host takes.
+		if (object && (object->properties & OBJSHARE_PERIPHERAL_OBJ_PROPERTY_READ) &&
+			(length == OBJSHARE_PROTOCOL_READ_PARAMETERS_SIZE))
 		{
+			uint16_t max_length = (uint16_t)parameters[0] | ((uint16_t)parameters[1] << 8);
+
 			EventOccurredDelegate ? EventOccurredDelegate(OBJSHARE_PERIPHERAL_READ_CHAR_EVENT,
 														  objId)
 								  : (void)0;
 
 			ObjshareProtocol_Send(OBJSHARE_PROTOCOL_PDUTYPE_READ_RESP,
-								  OPERATION_RESULT_SUCCESS,
-								  object->data, object->length);
+								  OPERATION_RESULT_SUCCESS, object->data,
+								  (max_length < object->length) ? max_length : object->length);
 		}
 		else
 		{
@@ -142,33 +243,316 @@ static void pduReceivedEventHandler(ObjshareProtocol_PduType_t pduType,
 	break;
 
 	case OBJSHARE_PROTOCOL_PDUTYPE_WRITE_REQ:
+	case OBJSHARE_PROTOCOL_PDUTYPE_WRITE_BROADCAST_REQ:
+	{
+		ObjsharePeripheral_Object_t *object = getObj(objId);
+		uint16_t offset = ObjshareProtocol_GetPduDataOffset();
+		uint8_t *data;
+		uint16_t length = ObjshareProtocol_ViewPduData(&data, unparsedPduSize);
+
+		// Write longer than the object is refused as a whole, before its first fragment reaches
+		//the object.
+		Bool_t is_writable = (object && (object->properties & OBJSHARE_PERIPHERAL_OBJ_PROPERTY_WRITE) &&
+							  (ObjshareProtocol_GetDataLength() <= object->length) &&
+							  (offset <= object->length) && (length <= (object->length - offset)))
+								 ? TRUE
+								 : FALSE;
+
+		// Copy pdu data from the frame into the object; fragments are placed at their offsets.
+		if (is_writable)
+		{
+#ifdef PACKET_MANAGER_STREAM
+			// Streamed into the shadow; object is updated at once with the last fragment.
+			if (object->shadow && (data == &object->shadow[offset]))
+			{
+				ObjshareProtocol_IsLastFragment() ? (void)memcpy(object->data, object->shadow, offset + length)
+												  : (void)0;
+			}
+			else
+#endif
+			{
+				memcpy(&object->data[offset], data, length);
+			}
+		}
+
+		// Respond when the last fragment is in.
+		if (!ObjshareProtocol_IsLastFragment())
+		{
+			break;
+		}
+
+		// If the object is writable; notify.
+		if (is_writable)
+		{
+			touch(object);
+
+			EventOccurredDelegate ? EventOccurredDelegate(OBJSHARE_PERIPHERAL_WRITE_CHAR_EVENT,
+														  objId)
+								  : (void)0;
+		}
+
+		// Broadcast is not responded to; every slot received it at once.
+		if (pduType == OBJSHARE_PROTOCOL_PDUTYPE_WRITE_BROADCAST_REQ)
+		{
+			break;
+		}
+
+		ObjshareProtocol_Send(OBJSHARE_PROTOCOL_PDUTYPE_WRITE_RESP,
+							  is_writable ? OPERATION_RESULT_SUCCESS : OPERATION_RESULT_FAILURE, 0, 0);
+	}
+	break;
+
+	case OBJSHARE_PROTOCOL_PDUTYPE_READ_MULTI_REQ:
+	{
+		uint8_t *obj_ids;
+		uint16_t count = ObjshareProtocol_ViewPduData(&obj_ids, unparsedPduSize);
+
+		if (count && (count <= OBJSHARE_PROTOCOL_MAX_MULTI_COUNT))
+		{
+			ObjshareProtocol_Send(OBJSHARE_PROTOCOL_PDUTYPE_READ_MULTI_RESP,
+								  OPERATION_RESULT_SUCCESS,
+								  MultiBuffer, readMulti(obj_ids, (uint8_t)count));
+		}
+		else
+		{
+			ObjshareProtocol_Send(OBJSHARE_PROTOCOL_PDUTYPE_READ_MULTI_RESP,
+								  OPERATION_RESULT_FAILURE, 0, 0);
+		}
+	}
+	break;
+
+	case OBJSHARE_PROTOCOL_PDUTYPE_WRITE_MULTI_REQ:
+	{
+		uint8_t *data;
+		uint16_t length;
+		uint8_t results[OBJSHARE_PROTOCOL_MULTI_BITMAP_SIZE];
+
+		// Fragments are collected and applied with the last one; a single pdu is applied in place.
+		if (ObjshareProtocol_GetPduDataOffset() || !ObjshareProtocol_IsLastFragment())
+		{
+			ObjshareProtocol_ParsePduData(MultiBuffer, sizeof(MultiBuffer), unparsedPduSize);
+
+			if (!ObjshareProtocol_IsLastFragment())
+			{
+				break;
+			}
+
+			data = MultiBuffer;
+			length = ObjshareProtocol_GetPduDataOffset() + unparsedPduSize;
+		}
+		else
+		{
+			length = ObjshareProtocol_ViewPduData(&data, unparsedPduSize);
+		}
+
+		// Object id is the number of objects.
+		uint8_t count = objId;
+
+		if (count && (count <= OBJSHARE_PROTOCOL_MAX_MULTI_COUNT) && (length <= sizeof(MultiBuffer)) &&
+			writeMulti(data, length, count, results))
+		{
+			ObjshareProtocol_Send(OBJSHARE_PROTOCOL_PDUTYPE_WRITE_MULTI_RESP,
+								  OPERATION_RESULT_SUCCESS,
+								  results, (count + 7) / 8);
+		}
+		else
+		{
+			ObjshareProtocol_Send(OBJSHARE_PROTOCOL_PDUTYPE_WRITE_MULTI_RESP,
+								  OPERATION_RESULT_FAILURE, 0, 0);
+		}
+	}
+	break;
+
+	case OBJSHARE_PROTOCOL_PDUTYPE_READ_RANGE_REQ:
+	{
+		ObjsharePeripheral_Object_t *object = getObj(objId);
+		uint8_t *parameters;
+		uint16_t length = ObjshareProtocol_ViewPduData(&parameters, unparsedPduSize);
+		uint16_t range_offset = 0;
+		uint16_t range_length = 0;
+		Bool_t is_readable = (object && (object->properties & OBJSHARE_PERIPHERAL_OBJ_PROPERTY_READ) &&
+							  (length == OBJSHARE_PROTOCOL_READ_RANGE_PARAMETERS_SIZE))
+								 ? TRUE
+								 : FALSE;
+
+		if (is_readable)
+		{
+			range_offset = (uint16_t)parameters[0] | ((uint16_t)parameters[1] << 8);
+			range_length = (uint16_t)parameters[2] | ((uint16_t)parameters[3] << 8);
+			is_readable = isInRange(object, range_offset, range_length);
+		}
+
+		// If the range is within a readable object; read and send it.
+		if (is_readable)
+		{
+			EventOccurredDelegate ? EventOccurredDelegate(OBJSHARE_PERIPHERAL_READ_CHAR_EVENT,
+														  objId)
+								  : (void)0;
+
+			ObjshareProtocol_Send(OBJSHARE_PROTOCOL_PDUTYPE_READ_RANGE_RESP,
+								  OPERATION_RESULT_SUCCESS,
+								  &object->data[range_offset], range_length);
+		}
+		else
+		{
+			ObjshareProtocol_Send(OBJSHARE_PROTOCOL_PDUTYPE_READ_RANGE_RESP,
+								  OPERATION_RESULT_FAILURE, 0, 0);
+		}
+	}
+	break;
+
+	case OBJSHARE_PROTOCOL_PDUTYPE_WRITE_RANGE_REQ:
 	{
 		ObjsharePeripheral_Object_t *object = getObj(objId);
+		uint8_t *data;
+		uint16_t length;
+
+		// Fragments are collected and applied with the last one; a single pdu is applied in place.
+		if (ObjshareProtocol_GetPduDataOffset() || !ObjshareProtocol_IsLastFragment())
+		{
+			ObjshareProtocol_ParsePduData(MultiBuffer, sizeof(MultiBuffer), unparsedPduSize);
+
+			if (!ObjshareProtocol_IsLastFragment())
+			{
+				break;
+			}
+
+			data = MultiBuffer;
+			length = ObjshareProtocol_GetPduDataOffset() + unparsedPduSize;
+		}
+		else
+		{
+			length = ObjshareProtocol_ViewPduData(&data, unparsedPduSize);
+		}
+
+		uint16_t range_offset = 0;
+		uint16_t range_length = 0;
+		Bool_t is_writable = (object && (object->properties & OBJSHARE_PERIPHERAL_OBJ_PROPERTY_WRITE) &&
+							  (length >= OBJSHARE_PROTOCOL_RANGE_OFFSET_SIZE) && (length <= sizeof(MultiBuffer)))
+								 ? TRUE
+								 : FALSE;
 
-		// If the object is writable; write it.
-		if (object && (object->properties & OBJSHARE_PERIPHERAL_OBJ_PROPERTY_WRITE))
+		if (is_writable)
 		{
-			// Parse pdu data.
-			ObjshareProtocol_ParsePduData(object->data, object->length,
-										  unparsedPduSize);
+			range_offset = (uint16_t)data[0] | ((uint16_t)data[1] << 8);
+			range_length = length - OBJSHARE_PROTOCOL_RANGE_OFFSET_SIZE;
+			is_writable = isInRange(object, range_offset, range_length);
+		}
+
+		// Range is written as a whole, or not at all.
+		if (is_writable)
+		{
+			memcpy(&object->data[range_offset], &data[OBJSHARE_PROTOCOL_RANGE_OFFSET_SIZE], range_length);
+			touch(object);
 
 			EventOccurredDelegate ? EventOccurredDelegate(OBJSHARE_PERIPHERAL_WRITE_CHAR_EVENT,
 														  objId)
 								  : (void)0;
 
-			// Send succeeded response.
-			ObjshareProtocol_Send(OBJSHARE_PROTOCOL_PDUTYPE_WRITE_RESP,
+			ObjshareProtocol_Send(OBJSHARE_PROTOCOL_PDUTYPE_WRITE_RANGE_RESP,
 								  OPERATION_RESULT_SUCCESS, 0, 0);
 		}
 		else
 		{
-			// Send failure response.
-			ObjshareProtocol_Send(OBJSHARE_PROTOCOL_PDUTYPE_WRITE_RESP,
+			ObjshareProtocol_Send(OBJSHARE_PROTOCOL_PDUTYPE_WRITE_RANGE_RESP,
+								  OPERATION_RESULT_FAILURE, 0, 0);
+		}
+	}
+	break;
+
+	case OBJSHARE_PROTOCOL_PDUTYPE_READ_DELTA_REQ:
+	{
+		ObjsharePeripheral_Object_t *object = getObj(objId);
+		uint8_t *parameters;
+		uint16_t length = ObjshareProtocol_ViewPduData(&parameters, unparsedPduSize);
+
+		// If the object is readable and fits into the response; read and send it, or its delta.
+		if (object && (object->properties & OBJSHARE_PERIPHERAL_OBJ_PROPERTY_READ) &&
+			(length == OBJSHARE_PROTOCOL_DELTA_BASELINE_SIZE) &&
+			(object->length <= (sizeof(MultiBuffer) - OBJSHARE_PROTOCOL_DELTA_HEADER_SIZE)))
+		{
+			EventOccurredDelegate ? EventOccurredDelegate(OBJSHARE_PERIPHERAL_READ_CHAR_EVENT,
+														  objId)
+								  : (void)0;
+
+			ObjshareProtocol_Send(OBJSHARE_PROTOCOL_PDUTYPE_READ_DELTA_RESP,
+								  OPERATION_RESULT_SUCCESS, MultiBuffer,
+								  readDelta(object, (uint16_t)parameters[0] | ((uint16_t)parameters[1] << 8)));
+		}
+		else
+		{
+			ObjshareProtocol_Send(OBJSHARE_PROTOCOL_PDUTYPE_READ_DELTA_RESP,
+								  OPERATION_RESULT_FAILURE, 0, 0);
+		}
+	}
+	break;
+
+	case OBJSHARE_PROTOCOL_PDUTYPE_READ_IF_CHANGED_REQ:
+	{
+		ObjsharePeripheral_Object_t *object = getObj(objId);
+		uint8_t *parameters;
+		uint16_t length = ObjshareProtocol_ViewPduData(&parameters, unparsedPduSize);
+
+		if (!object || !(object->properties & OBJSHARE_PERIPHERAL_OBJ_PROPERTY_READ) ||
+			(length != OBJSHARE_PROTOCOL_VERSION_SIZE) ||
+			(object->length > (sizeof(MultiBuffer) - OBJSHARE_PROTOCOL_VERSION_SIZE)))
+		{
+			ObjshareProtocol_Send(OBJSHARE_PROTOCOL_PDUTYPE_READ_IF_CHANGED_RESP,
+								  OPERATION_RESULT_FAILURE, 0, 0);
+		}
+		else if (((uint16_t)parameters[0] | ((uint16_t)parameters[1] << 8)) == object->version)
+		{
+			ObjshareProtocol_Send(OBJSHARE_PROTOCOL_PDUTYPE_READ_IF_CHANGED_RESP,
+								  OBJSHARE_PROTOCOL_OPERATION_RESULT_NOT_MODIFIED, 0, 0);
+		}
+		else
+		{
+			EventOccurredDelegate ? EventOccurredDelegate(OBJSHARE_PERIPHERAL_READ_CHAR_EVENT,
+														  objId)
+								  : (void)0;
+
+			MultiBuffer[0] = (uint8_t)object->version;
+			MultiBuffer[1] = (uint8_t)(object->version >> 8);
+			memcpy(&MultiBuffer[OBJSHARE_PROTOCOL_VERSION_SIZE], object->data, object->length);
+
+			ObjshareProtocol_Send(OBJSHARE_PROTOCOL_PDUTYPE_READ_IF_CHANGED_RESP,
+								  OPERATION_RESULT_SUCCESS, MultiBuffer,
+								  OBJSHARE_PROTOCOL_VERSION_SIZE + object->length);
+		}
+	}
+	break;
+
+	case OBJSHARE_PROTOCOL_PDUTYPE_GET_CHANGES_REQ:
+	{
+		uint8_t *parameters;
+		uint16_t length = ObjshareProtocol_ViewPduData(&parameters, unparsedPduSize);
+
+		if (length == OBJSHARE_PROTOCOL_JOURNAL_SEQUENCE_SIZE)
+		{
+			ObjshareProtocol_Send(OBJSHARE_PROTOCOL_PDUTYPE_GET_CHANGES_RESP,
+								  OPERATION_RESULT_SUCCESS, MultiBuffer,
+								  getChanges((uint16_t)parameters[0] | ((uint16_t)parameters[1] << 8)));
+		}
+		else
+		{
+			ObjshareProtocol_Send(OBJSHARE_PROTOCOL_PDUTYPE_GET_CHANGES_RESP,
 								  OPERATION_RESULT_FAILURE, 0, 0);
 		}
 	}
 	break;
 
+	case OBJSHARE_PROTOCOL_PDUTYPE_SUBSCRIBE_REQ:
+	{
+		uint8_t *parameters;
+		uint16_t length = ObjshareProtocol_ViewPduData(&parameters, unparsedPduSize);
+
+		ObjshareProtocol_Send(OBJSHARE_PROTOCOL_PDUTYPE_SUBSCRIBE_RESP,
+							  subscribe(objId, parameters, length) ? OPERATION_RESULT_SUCCESS
+																   : OPERATION_RESULT_FAILURE,
+							  0, 0);
+	}
+	break;
+
 	case OBJSHARE_PROTOCOL_PDUTYPE_POLL_REQ:
 	{
 		// Say I'm here!
@@ -194,6 +578,420 @@ static ObjsharePeripheral_Object_t *getObj(uint8_t objId)
 	return 0;
 }
 
+// Fills the multi buffer with the result of each object, then the data of the objects read.
+//Objects not readable, or not fitting into the rest of the buffer, fail on their own.
+static uint16_t readMulti(uint8_t *objIds, uint8_t count)
+{
+	uint16_t length = (uint16_t)count * OBJSHARE_PROTOCOL_MULTI_RESULT_SIZE;
+
+	for (uint8_t i = 0; i < count; i++)
+	{
+		ObjsharePeripheral_Object_t *object = getObj(objIds[i]);
+		uint8_t *result = &MultiBuffer[i * OBJSHARE_PROTOCOL_MULTI_RESULT_SIZE];
+
+		if (object && (object->properties & OBJSHARE_PERIPHERAL_OBJ_PROPERTY_READ) &&
+			(object->length <= (sizeof(MultiBuffer) - length)))
+		{
+			EventOccurredDelegate ? EventOccurredDelegate(OBJSHARE_PERIPHERAL_READ_CHAR_EVENT,
+														  objIds[i])
+								  : (void)0;
+
+			memcpy(&MultiBuffer[length], object->data, object->length);
+			length += object->length;
+
+			result[0] = OPERATION_RESULT_SUCCESS;
+			result[1] = (uint8_t)object->length;
+			result[2] = (uint8_t)(object->length >> 8);
+		}
+		else
+		{
+			result[0] = OPERATION_RESULT_FAILURE;
+			result[1] = 0;
+			result[2] = 0;
+		}
+	}
+
+	return length;
+}
+
+// Writes each object of a write multi request and sets its bit in the results when it is
+//writable and the data fits. Request is refused as a whole unless its objects fill it exactly;
+//nothing is written then.
+static Bool_t writeMulti(uint8_t *data, uint16_t length, uint8_t count, uint8_t *results)
+{
+	uint32_t idx = 0;
+
+	for (uint8_t i = 0; i < count; i++)
+	{
+		if ((length - idx) < OBJSHARE_PROTOCOL_MULTI_WRITE_HEADER_SIZE)
+		{
+			return FALSE;
+		}
+
+		idx += OBJSHARE_PROTOCOL_MULTI_WRITE_HEADER_SIZE +
+			   ((uint16_t)data[idx + 1] | ((uint16_t)data[idx + 2] << 8));
+
+		if (idx > length)
+		{
+			return FALSE;
+		}
+	}
+
+	if (idx != length)
+	{
+		return FALSE;
+	}
+
+	memset(results, 0, OBJSHARE_PROTOCOL_MULTI_BITMAP_SIZE);
+	idx = 0;
+
+	for (uint8_t i = 0; i < count; i++)
+	{
+		uint8_t obj_id = data[idx];
+		uint16_t data_length = (uint16_t)data[idx + 1] | ((uint16_t)data[idx + 2] << 8);
+
+		idx += OBJSHARE_PROTOCOL_MULTI_WRITE_HEADER_SIZE;
+
+		ObjsharePeripheral_Object_t *object = getObj(obj_id);
+
+		if (object && (object->properties & OBJSHARE_PERIPHERAL_OBJ_PROPERTY_WRITE) &&
+			(data_length <= object->length))
+		{
+			memcpy(object->data, &data[idx], data_length);
+			touch(object);
+
+			EventOccurredDelegate ? EventOccurredDelegate(OBJSHARE_PERIPHERAL_WRITE_CHAR_EVENT,
+														  obj_id)
+								  : (void)0;
+
+			results[i >> 3] |= (uint8_t)(1U << (i & 0x07));
+		}
+
+		idx += data_length;
+	}
+
+	return TRUE;
+}
+
+static void touch(ObjsharePeripheral_Object_t *object)
+{
+	object->version = (object->version == 0xFFFF) ? 1 : (object->version + 1);
+
+	Journal[JournalSequence++ & (OBJSHARE_PERIPHERAL_JOURNAL_LENGTH - 1)] = object->objId;
+	JournalCount += (JournalCount < OBJSHARE_PERIPHERAL_JOURNAL_LENGTH) ? 1 : 0;
+}
+
+static Bool_t isInRange(ObjsharePeripheral_Object_t *object, uint16_t offset, uint16_t length)
+{
+	return (((uint32_t)offset + length) <= object->length) ? TRUE : FALSE;
+}
+
+// Fills the multi buffer with the journal sequence to ask from next, then the ids of the
+//registered objects changed since the given sequence, each once. Every registered object is
+//listed when the sequence is 0 or its changes are not in the journal any more. Returns the length
+//of the response.
+static uint16_t getChanges(uint16_t sequence)
+{
+	uint16_t change_count = JournalSequence - sequence;
+	uint16_t length = OBJSHARE_PROTOCOL_JOURNAL_SEQUENCE_SIZE;
+
+	MultiBuffer[0] = (uint8_t)JournalSequence;
+	MultiBuffer[1] = (uint8_t)(JournalSequence >> 8);
+
+	if (!sequence || (change_count > JournalCount))
+	{
+		for (uint8_t i = 0; (i < NumOfObjects) && (i < OBJSHARE_PROTOCOL_MAX_CHANGE_COUNT); i++)
+		{
+			MultiBuffer[length++] = ObjectTable[i].objId;
+		}
+
+		return length;
+	}
+
+	for (; sequence != JournalSequence; sequence++)
+	{
+		uint8_t obj_id = Journal[sequence & (OBJSHARE_PERIPHERAL_JOURNAL_LENGTH - 1)];
+		uint8_t *obj_ids = &MultiBuffer[OBJSHARE_PROTOCOL_JOURNAL_SEQUENCE_SIZE];
+		uint16_t count = length - OBJSHARE_PROTOCOL_JOURNAL_SEQUENCE_SIZE;
+
+		// Objects registered fit into the list; those gone since are left out.
+		if (!getObj(obj_id) || memchr(obj_ids, obj_id, count) || (count >= OBJSHARE_PROTOCOL_MAX_CHANGE_COUNT))
+		{
+			continue;
+		}
+
+		MultiBuffer[length++] = obj_id;
+	}
+
+	return length;
+}
+
+// Fills the multi buffer with the read delta response; the delta against the value the host
+//holds if this is the value last sent to it, and the delta is shorter than the object. Returns
+//the length of the response.
+static uint16_t readDelta(ObjsharePeripheral_Object_t *object, uint16_t baselineNumber)
+{
+	DeltaBaseline_t *baseline = getDeltaBaseline(object);
+	uint8_t *payload = &MultiBuffer[OBJSHARE_PROTOCOL_DELTA_HEADER_SIZE];
+	uint16_t length = 0;
+
+	MultiBuffer[0] = OBJSHARE_PROTOCOL_DELTA_ENCODING_FULL;
+
+	if (baseline && baselineNumber && (baseline->number == baselineNumber) &&
+		encodeDelta(baseline->value, object->data, object->length, payload, &length))
+	{
+		MultiBuffer[0] = OBJSHARE_PROTOCOL_DELTA_ENCODING_XOR_RLE;
+	}
+	else
+	{
+		memcpy(payload, object->data, object->length);
+		length = object->length;
+	}
+
+	// Value sent is the base of the next delta.
+	baselineNumber = 0;
+
+	if (baseline)
+	{
+		memcpy(baseline->value, object->data, object->length);
+
+		NextDeltaBaselineNumber = NextDeltaBaselineNumber ? NextDeltaBaselineNumber : 1;
+		baseline->number = NextDeltaBaselineNumber++;
+		baselineNumber = baseline->number;
+	}
+
+	MultiBuffer[1] = (uint8_t)baselineNumber;
+	MultiBuffer[2] = (uint8_t)(baselineNumber >> 8);
+
+	return OBJSHARE_PROTOCOL_DELTA_HEADER_SIZE + length;
+}
+
+// Returns the value kept for the object, or gives up the one kept longest for it; 0 if the
+//object is too large to be kept.
+static DeltaBaseline_t *getDeltaBaseline(ObjsharePeripheral_Object_t *object)
+{
+	if (object->length > OBJSHARE_PERIPHERAL_MAX_DELTA_SIZE)
+	{
+		return 0;
+	}
+
+	for (uint8_t i = 0; i < OBJSHARE_PERIPHERAL_MAX_DELTA_COUNT; i++)
+	{
+		if (DeltaBaselines[i].number && (DeltaBaselines[i].objId == object->objId))
+		{
+			return &DeltaBaselines[i];
+		}
+	}
+
+	DeltaBaseline_t *baseline = &DeltaBaselines[NextDeltaBaselineIdx];
+
+	NextDeltaBaselineIdx = (NextDeltaBaselineIdx + 1) % OBJSHARE_PERIPHERAL_MAX_DELTA_COUNT;
+
+	baseline->objId = object->objId;
+	baseline->number = 0;
+
+	return baseline;
+}
+
+// Encodes the changes of the value as unchanged and changed byte count tokens followed by the
+//changed bytes xor'ed with the baseline. Fails unless the delta is shorter than the value.
+static Bool_t encodeDelta(uint8_t *baseline, uint8_t *value, uint16_t length, uint8_t *delta,
+						  uint16_t *deltaLength)
+{
+	uint16_t idx = 0;
+	uint16_t delta_idx = 0;
+
+	while (idx < length)
+	{
+		uint8_t unchanged_count = 0;
+		uint8_t changed_count = 0;
+
+		while ((idx < length) && (unchanged_count < 0xFF) && (value[idx] == baseline[idx]))
+		{
+			unchanged_count++;
+			idx++;
+		}
+
+		// Unchanged bytes at the end need no token.
+		if (idx == length)
+		{
+			break;
+		}
+
+		while (((idx + changed_count) < length) && (changed_count < 0xFF) &&
+			   (value[idx + changed_count] != baseline[idx + changed_count]))
+		{
+			changed_count++;
+		}
+
+		if ((delta_idx + OBJSHARE_PROTOCOL_DELTA_TOKEN_SIZE + changed_count) >= length)
+		{
+			return FALSE;
+		}
+
+		delta[delta_idx++] = unchanged_count;
+		delta[delta_idx++] = changed_count;
+
+		for (; changed_count; changed_count--, idx++)
+		{
+			delta[delta_idx++] = value[idx] ^ baseline[idx];
+		}
+	}
+
+	*deltaLength = delta_idx;
+
+	return TRUE;
+}
+
+// Starts or updates the subscription to the object; ends it when there are no parameters.
+//Object's value at the time is the one its changes are measured from.
+static Bool_t subscribe(uint8_t objId, uint8_t *parameters, uint16_t length)
+{
+	Subscription_t *subscription = getSubscription(objId);
+	ObjsharePeripheral_Object_t *object = getObj(objId);
+
+	if (!length)
+	{
+		subscription ? (void)(subscription->isActive = FALSE) : (void)0;
+		return TRUE;
+	}
+
+	if (!subscription || (length != OBJSHARE_PROTOCOL_SUBSCRIBE_PARAMETERS_SIZE) || !object ||
+		!(object->properties & OBJSHARE_PERIPHERAL_OBJ_PROPERTY_READ) ||
+		(object->length > OBJSHARE_PERIPHERAL_MAX_SUBSCRIPTION_SIZE))
+	{
+		return FALSE;
+	}
+
+	subscription->notification[0] = parameters[0];
+	subscription->notification[1] = objId;
+	memcpy(&subscription->notification[OBJSHARE_PROTOCOL_NOTIFY_HEADER_SIZE], object->data, object->length);
+
+	subscription->minInterval = (uint16_t)parameters[1] | ((uint16_t)parameters[2] << 8);
+	memcpy(&subscription->deadband, &parameters[3], sizeof(subscription->deadband));
+	subscription->timestamp = SysTime_GetTimeInMs();
+	subscription->isPending = FALSE;
+	subscription->isActive = TRUE;
+
+	return TRUE;
+}
+
+// Returns the subscription to the object, or a free one if there is none; 0 if all are taken.
+static Subscription_t *getSubscription(uint8_t objId)
+{
+	Subscription_t *free_subscription = 0;
+
+	for (uint8_t i = 0; i < OBJSHARE_PERIPHERAL_MAX_SUBSCRIPTION_COUNT; i++)
+	{
+		Subscription_t *subscription = &Subscriptions[i];
+
+		if (!subscription->isActive)
+		{
+			free_subscription = free_subscription ? free_subscription : subscription;
+		}
+		else if (subscription->notification[1] == objId)
+		{
+			return subscription;
+		}
+	}
+
+	return free_subscription;
+}
+
+// Sends the value of each subscribed object which changed, once its minimum interval has passed
+//since the last notification. A notification not taken by the full transmit queue is sent on a
+//later call.
+static void notifySubscribers(void)
+{
+	Bool_t is_addressed = IsAddressedDelegate ? IsAddressedDelegate() : TRUE;
+
+	// Line is kept by the fragments of a response until the last one is out, and shared by every
+	//peripheral after a broadcast.
+	if (!is_addressed || IsBroadcastAddressed || ObjshareProtocol_GetPendingFragmentCount())
+	{
+		return;
+	}
+
+	uint32_t sys_time = SysTime_GetTimeInMs();
+
+	for (uint8_t i = 0; i < OBJSHARE_PERIPHERAL_MAX_SUBSCRIPTION_COUNT; i++)
+	{
+		Subscription_t *subscription = &Subscriptions[i];
+
+		if (!subscription->isActive || ((sys_time - subscription->timestamp) < subscription->minInterval))
+		{
+			continue;
+		}
+
+		ObjsharePeripheral_Object_t *object = getObj(subscription->notification[1]);
+
+		// Object is gone, or was registered again larger than it can be notified.
+		if (!object || (object->length > OBJSHARE_PERIPHERAL_MAX_SUBSCRIPTION_SIZE))
+		{
+			subscription->isActive = FALSE;
+			continue;
+		}
+
+		if (!subscription->isPending && !isChanged(subscription, object))
+		{
+			continue;
+		}
+
+		memcpy(&subscription->notification[OBJSHARE_PROTOCOL_NOTIFY_HEADER_SIZE], object->data, object->length);
+
+		subscription->isPending = !ObjshareProtocol_Send(OBJSHARE_PROTOCOL_PDUTYPE_NOTIFY,
+														 OPERATION_RESULT_SUCCESS, subscription->notification,
+														 OBJSHARE_PROTOCOL_NOTIFY_HEADER_SIZE + object->length);
+
+		if (subscription->isPending)
+		{
+			return;
+		}
+
+		subscription->timestamp = sys_time;
+	}
+}
+
+// Float objects are changed once they moved by the deadband; others by any change.
+static Bool_t isChanged(Subscription_t *subscription, ObjsharePeripheral_Object_t *object)
+{
+	uint8_t *value = &subscription->notification[OBJSHARE_PROTOCOL_NOTIFY_HEADER_SIZE];
+
+	if ((object->length == sizeof(float)) && (subscription->deadband > 0.0f))
+	{
+		float current;
+		float last;
+
+		memcpy(&current, object->data, sizeof(current));
+		memcpy(&last, value, sizeof(last));
+
+		return (((current - last) >= subscription->deadband) || ((last - current) >= subscription->deadband))
+				   ? TRUE
+				   : FALSE;
+	}
+
+	return memcmp(value, object->data, object->length) ? TRUE : FALSE;
+}
+
+#ifdef PACKET_MANAGER_STREAM
+static uint8_t *pduDataSinkEventHandler(uint8_t objId, uint16_t offset, uint16_t *capacity)
+{
+	ObjsharePeripheral_Object_t *object = getObj(objId);
+
+	// Objects without a shadow are written from the inbox, fragment by fragment.
+	if (!object || !object->shadow || !(object->properties & OBJSHARE_PERIPHERAL_OBJ_PROPERTY_WRITE))
+	{
+		return 0;
+	}
+
+	// Data past the object is not kept; the frame is still validated and the write refused.
+	offset = (offset < object->length) ? offset : object->length;
+	*capacity = OBJSHARE_PERIPHERAL_SHADOW_SIZE(object->length) - offset;
+
+	return &object->shadow[offset];
+}
+#endif
+
 static uint8_t getObjIdx(uint8_t objId)
 {
 	for (uint8_t i = 0; i < NumOfObjects; i++)
@@ -8,12 +8,36 @@ extern "C"
 
 #include "generic.h"
 #include "objshare_protocol.h"
+#include "packet_manager.h"
 
 /* Exported definitions ----------------------------------------------------*/
 #define OBJSHARE_PERIPHERAL_MAX_NUMBER_OF_CHARS 16
 #define OBJSHARE_PERIPHERAL_OBJ_PROPERTY_READ 0x01
 #define OBJSHARE_PERIPHERAL_OBJ_PROPERTY_WRITE 0x02
 
+// With PACKET_MANAGER_STREAM, writes to an object given a shadow are decoded into it straight
+//from the receive ring and copied into the object only when the whole write is validated; so the
+//inbox need not hold them. Shadow takes the frame's crc past the data.
+#define OBJSHARE_PERIPHERAL_SHADOW_SIZE(objSize) ((objSize) + PACKET_MANAGER_FRAME_CRC_SIZE)
+
+// Objects the host may be subscribed to at once, and the size of the largest. A notification is
+//sent from ObjsharePeripheral_Execute while the peripheral is addressed and no response is being
+//fragmented; so it needs a line the peripheral may transmit on unrequested, such as a point to
+//point link. After a broadcast write every peripheral is addressed, so notifications are held
+//until the host sends a request to this peripheral alone, e.g. a poll.
+#define OBJSHARE_PERIPHERAL_MAX_SUBSCRIPTION_COUNT 8
+#define OBJSHARE_PERIPHERAL_MAX_SUBSCRIPTION_SIZE 16
+
+// Objects whose value last sent in a read delta response is kept as the base of the next delta,
+//and the size of the largest. Larger objects are always sent whole; beyond the count, the value
+//kept longest is given up for a new one.
+#define OBJSHARE_PERIPHERAL_MAX_DELTA_COUNT 4
+#define OBJSHARE_PERIPHERAL_MAX_DELTA_SIZE 64
+
+// Changes kept in the journal the host asks for the objects changed since it last asked; a power
+//of two. Host asking from a change no longer kept gets every object.
+#define OBJSHARE_PERIPHERAL_JOURNAL_LENGTH 32
+
 	/* Exported types ------------------------------------------------------------*/
 	enum
 	{
@@ -33,15 +57,21 @@ extern "C"
 	// Delegates.
 	typedef void (*ObjsharePeripheral_EventOccurredDelegate_t)(ObjsharePeripheral_Event_t event,
 															   uint8_t objId);
+	// Has to be TRUE also while the host addresses every slot for a broadcast write.
 	typedef Bool_t (*ObjsharePeripheral_IsAddressedDelegate_t)(void);
 
-	// Objshare struct.
+	// Objshare struct. Version starts from 1 when registered and is bumped by every write,
+	//skipping 0; the write is recorded in the journal as well.
 	typedef struct
 	{
 		uint8_t objId;
 		uint8_t *data;
 		uint16_t length;
 		uint8_t properties;
+		uint16_t version;
+#ifdef PACKET_MANAGER_STREAM
+		uint8_t *shadow;
+#endif
 	} ObjsharePeripheral_Object_t;
 
 	/* Exported functions --------------------------------------------------------*/
@@ -53,10 +83,30 @@ extern "C"
 	extern void ObjsharePeripheral_Register(uint8_t objId, void *obj, uint16_t objSize,
 											uint8_t properties);
 	extern void ObjsharePeripheral_DeRegister(uint8_t objId);
+
+#ifdef PACKET_MANAGER_STREAM
+	/***
+	 * @Brief      Gives a registered object a shadow; the object then takes up twice its size,
+	 *             while the inbox may be smaller than its writes.
+	 *
+	 * @Params     objId-> Object to be shadowed.
+	 *             shadow-> Buffer of OBJSHARE_PERIPHERAL_SHADOW_SIZE(objSize) bytes; 0 writes the
+	 *             object through the inbox again.
+	 */
+	extern void ObjsharePeripheral_SetShadow(uint8_t objId, uint8_t *shadow);
+#endif
 	extern void ObjsharePeripheral_Start(void);
 	extern void ObjsharePeripheral_Execute(void);
 	extern void ObjsharePeripheral_Stop(void);
 
+	/***
+	 * @Brief      Bumps the version of an object changed by the firmware, so that the host reads
+	 *             it again; writes by the host bump it themselves.
+	 *
+	 * @Params     objId-> Object changed.
+	 */
+	extern void ObjsharePeripheral_Touch(uint8_t objId);
+
 	// Functions to control object server database.
 	extern ObjsharePeripheral_Object_t *ObjsharePeripheral_ParseObject(uint8_t objId);
 
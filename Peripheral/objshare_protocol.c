@@ -4,9 +4,30 @@
 /* Includes ------------------------------------------------------------------*/
 #include "packet_manager.h"
 #include "objshare_protocol.h"
+#include "trace.h"
+
+/* Private typedefs ----------------------------------------------------------*/
+// Data being sent in fragments. Argument is the object id on host, operation result on
+//peripheral.
+typedef struct
+{
+	ObjshareProtocol_PduType_t pduType;
+	uint8_t pduSequence;
+	uint8_t argument;
+	uint8_t *data;
+	uint16_t dataLength;
+	uint8_t sequence;
+	uint8_t count;
+} Fragmentation_t;
 
 /* Private function prototypes -----------------------------------------------*/
 static void packetManagerEventHandler(PacketManager_Event_t event, uint16_t unparsedPduSize);
+static void sendFragments(void);
+static void switchDirection(ObjshareProtocol_Direction_t direction);
+#if defined(OBJSHARE_PROTOCOL_PERIPHERAL) && defined(PACKET_MANAGER_STREAM)
+static uint16_t streamEventHandler(uint8_t *header, uint16_t headerLength,
+								   PacketManager_PduField_t *sink);
+#endif
 
 /* Private variable declarations ---------------------------------------------*/
 // State variables.
@@ -15,6 +36,23 @@ static ObjshareProtocol_State_t State = OBJSHARE_PROTOCOL_STATE_UNINIT;
 // Variables to store delegate pointers.
 static ObjshareProtocol_PduReceivedDelegate_t PduReceivedDelegate;
 static ObjshareProtocol_SwitchDirectionDelegate_t SwitchDirectionDelegate;
+#ifdef OBJSHARE_PROTOCOL_PERIPHERAL
+static ObjshareProtocol_PduDataSinkDelegate_t PduDataSinkDelegate;
+#endif
+
+// Fragmented data being sent.
+static Fragmentation_t TxFragmentation;
+
+// Sequence number of the pdu received last.
+static uint8_t RxPduSequence;
+
+// Reassembly of the received data; fragments are accepted in order only.
+static uint8_t RxNextSequence;
+static uint8_t RxFragmentCount;
+static uint16_t RxFragmentDataLength;
+static uint16_t RxDataLength;
+static uint16_t RxDataOffset;
+static Bool_t RxLastFragment = TRUE;
 
 /* Exported functions --------------------------------------------------------*/
 #ifdef OBJSHARE_PROTOCOL_HOST
@@ -42,7 +80,7 @@ void ObjshareProtocol_Start(void)
 	// Start packet manager.
 	PacketManager_Start();
 
-	SwitchDirectionDelegate ? SwitchDirectionDelegate(OBJSHARE_PROTOCOL_DIRECTION_RX) : (void)0;
+	switchDirection(OBJSHARE_PROTOCOL_DIRECTION_RX);
 
 	// Set state.
 	State = OBJSHARE_PROTOCOL_STATE_OPERATING;
@@ -57,6 +95,12 @@ void ObjshareProtocol_Execute(void)
 
 	// Execute sub-module.
 	PacketManager_Execute();
+
+	// Queue the fragments the packet manager could not take yet.
+	if (ObjshareProtocol_GetPendingFragmentCount())
+	{
+		sendFragments();
+	}
 }
 
 void ObjshareProtocol_Stop(void)
@@ -66,54 +110,102 @@ void ObjshareProtocol_Stop(void)
 }
 
 #ifdef OBJSHARE_PROTOCOL_HOST
-void ObjshareProtocol_Send(uint8_t slot, ObjshareProtocol_PduType_t pduType,
-						   uint8_t objId, uint8_t *data, uint16_t dataLength)
+Bool_t ObjshareProtocol_Send(uint8_t slot, ObjshareProtocol_PduType_t pduType, uint8_t sequence,
+							 uint8_t objId, uint8_t *data, uint16_t dataLength)
 #else
-void ObjshareProtocol_Send(ObjshareProtocol_PduType_t pduType, OperationResult_t operationResult,
-						   uint8_t *data, uint16_t dataLength)
+Bool_t ObjshareProtocol_Send(ObjshareProtocol_PduType_t pduType, OperationResult_t operationResult,
+							 uint8_t *data, uint16_t dataLength)
 
 #endif
 {
 	if (State != OBJSHARE_PROTOCOL_STATE_OPERATING)
 	{
-		return;
+		return FALSE;
+	}
+
+#ifdef OBJSHARE_PROTOCOL_PERIPHERAL
+	// Answer to the request received last.
+	uint8_t sequence = RxPduSequence;
+#endif
+
+	// A new pdu drops the fragments of the previous one.
+	TxFragmentation.count = 0;
+	TxFragmentation.sequence = 0;
+
+	if (dataLength > OBJSHARE_PROTOCOL_MAX_FRAGMENT_SIZE)
+	{
+		uint16_t fragment_count = (dataLength + OBJSHARE_PROTOCOL_MAX_FRAGMENT_SIZE - 1) /
+								  OBJSHARE_PROTOCOL_MAX_FRAGMENT_SIZE;
+
+		if (fragment_count > 0xFF)
+		{
+			return FALSE;
+		}
+
+		TxFragmentation.pduType = pduType;
+		TxFragmentation.pduSequence = sequence;
+#ifdef OBJSHARE_PROTOCOL_HOST
+		TxFragmentation.argument = objId;
+#else
+		TxFragmentation.argument = operationResult;
+#endif
+		TxFragmentation.data = data;
+		TxFragmentation.dataLength = dataLength;
+		TxFragmentation.count = (uint8_t)fragment_count;
+
+		switchDirection(OBJSHARE_PROTOCOL_DIRECTION_TX);
+
+		sendFragments();
+
+		return TRUE;
 	}
 
 	PacketManager_PduField_t pdu_fields[4];
+	uint8_t pdu_header[2] = {pduType, sequence};
 	uint8_t idx = 0;
 
-	SwitchDirectionDelegate ? SwitchDirectionDelegate(OBJSHARE_PROTOCOL_DIRECTION_TX)
-							: (void)0;
+	switchDirection(OBJSHARE_PROTOCOL_DIRECTION_TX);
 
-	// Add type field.
-	pdu_fields[idx].data = (uint8_t *)&pduType;
-	pdu_fields[idx++].length = sizeof(pduType);
+	// Add type and sequence fields.
+	pdu_fields[idx].data = pdu_header;
+	pdu_fields[idx++].length = sizeof(pdu_header);
 
 	// Add pdu specific fields.
 	switch (pduType)
 	{
 #ifdef OBJSHARE_PROTOCOL_HOST
 	case OBJSHARE_PROTOCOL_PDUTYPE_READ_REQ:
+	case OBJSHARE_PROTOCOL_PDUTYPE_WRITE_REQ:
+	case OBJSHARE_PROTOCOL_PDUTYPE_WRITE_MULTI_REQ:
+	case OBJSHARE_PROTOCOL_PDUTYPE_WRITE_BROADCAST_REQ:
+	case OBJSHARE_PROTOCOL_PDUTYPE_SUBSCRIBE_REQ:
+	case OBJSHARE_PROTOCOL_PDUTYPE_READ_RANGE_REQ:
+	case OBJSHARE_PROTOCOL_PDUTYPE_WRITE_RANGE_REQ:
+	case OBJSHARE_PROTOCOL_PDUTYPE_READ_DELTA_REQ:
+	case OBJSHARE_PROTOCOL_PDUTYPE_READ_IF_CHANGED_REQ:
 	{
 		// Add object id.
 		pdu_fields[idx].data = &objId;
 		pdu_fields[idx++].length = sizeof(objId);
+
+		// Add data.
+		pdu_fields[idx].data = data;
+		pdu_fields[idx++].length = dataLength;
 	}
 	break;
 
-	case OBJSHARE_PROTOCOL_PDUTYPE_WRITE_REQ:
+	case OBJSHARE_PROTOCOL_PDUTYPE_READ_MULTI_REQ:
+	case OBJSHARE_PROTOCOL_PDUTYPE_GET_CHANGES_REQ:
 	{
-		// Add object id.
-		pdu_fields[idx].data = &objId;
-		pdu_fields[idx++].length = sizeof(objId);
-
-		// Add data.
+		// Add object ids, or journal sequence.
 		pdu_fields[idx].data = data;
 		pdu_fields[idx++].length = dataLength;
 	}
 	break;
 #else
 	case OBJSHARE_PROTOCOL_PDUTYPE_WRITE_RESP:
+	case OBJSHARE_PROTOCOL_PDUTYPE_SUBSCRIBE_RESP:
+	case OBJSHARE_PROTOCOL_PDUTYPE_WRITE_RANGE_RESP:
 	{
 		// Add operation result.
 		pdu_fields[idx].data = (uint8_t *)&operationResult;
@@ -122,6 +214,13 @@ void ObjshareProtocol_Send(ObjshareProtocol_PduType_t pduType, OperationResult_t
 	break;
 
 	case OBJSHARE_PROTOCOL_PDUTYPE_READ_RESP:
+	case OBJSHARE_PROTOCOL_PDUTYPE_READ_MULTI_RESP:
+	case OBJSHARE_PROTOCOL_PDUTYPE_WRITE_MULTI_RESP:
+	case OBJSHARE_PROTOCOL_PDUTYPE_NOTIFY:
+	case OBJSHARE_PROTOCOL_PDUTYPE_READ_RANGE_RESP:
+	case OBJSHARE_PROTOCOL_PDUTYPE_READ_DELTA_RESP:
+	case OBJSHARE_PROTOCOL_PDUTYPE_READ_IF_CHANGED_RESP:
+	case OBJSHARE_PROTOCOL_PDUTYPE_GET_CHANGES_RESP:
 	{
 		// Add operation result.
 		pdu_fields[idx].data = (uint8_t *)&operationResult;
@@ -138,14 +237,64 @@ void ObjshareProtocol_Send(ObjshareProtocol_PduType_t pduType, OperationResult_t
 		break;
 	}
 
-	PacketManager_Send(pdu_fields, idx);
+	return PacketManager_Send(pdu_fields, idx);
 }
 
 void ObjshareProtocol_ParsePduData(uint8_t *data, uint16_t length, uint16_t unparsedPduSize)
 {
-	PacketManager_ParseField(data, length, unparsedPduSize);
+	// Fragment's data goes to its place in the destination.
+	if (RxDataOffset < length)
+	{
+		PacketManager_ParseField(&data[RxDataOffset], length - RxDataOffset, unparsedPduSize);
+	}
+}
+
+uint16_t ObjshareProtocol_ViewPduData(uint8_t **data, uint16_t unparsedPduSize)
+{
+	PacketManager_PduField_t field;
+
+	PacketManager_ViewField(&field, unparsedPduSize, unparsedPduSize);
+	*data = field.data;
+
+	return field.length;
+}
+
+uint16_t ObjshareProtocol_GetPduDataOffset(void)
+{
+	return RxDataOffset;
+}
+
+uint8_t ObjshareProtocol_GetPendingFragmentCount(void)
+{
+	return TxFragmentation.count - TxFragmentation.sequence;
 }
 
+Bool_t ObjshareProtocol_IsLastFragment(void)
+{
+	return RxLastFragment;
+}
+
+uint16_t ObjshareProtocol_GetDataLength(void)
+{
+	return RxDataLength;
+}
+
+uint8_t ObjshareProtocol_GetPduSequence(void)
+{
+	return RxPduSequence;
+}
+
+#ifdef OBJSHARE_PROTOCOL_PERIPHERAL
+void ObjshareProtocol_SetPduDataSinkDelegate(ObjshareProtocol_PduDataSinkDelegate_t pduDataSinkHandler)
+{
+	PduDataSinkDelegate = pduDataSinkHandler;
+
+#ifdef PACKET_MANAGER_STREAM
+	PacketManager_SetStreamDelegate(pduDataSinkHandler ? &streamEventHandler : 0);
+#endif
+}
+#endif
+
 ObjshareProtocol_State_t ObjshareProtocol_GetState(void)
 {
 	return State;
@@ -169,14 +318,21 @@ void packetManagerEventHandler(PacketManager_Event_t event, uint16_t unparsedPdu
 	// Packet transmission is completed and switch to receiving state.
 	if (event == PACKET_MANAGER_TRANSMISSION_COMPLETED_EVENT)
 	{
-		SwitchDirectionDelegate ? SwitchDirectionDelegate(OBJSHARE_PROTOCOL_DIRECTION_RX)
-								: (void)0;
+		// Line is kept until the last fragment is out.
+		if (ObjshareProtocol_GetPendingFragmentCount())
+		{
+			sendFragments();
+			return;
+		}
+
+		switchDirection(OBJSHARE_PROTOCOL_DIRECTION_RX);
 
 		return;
 	}
 
 	ObjshareProtocol_PduType_t pdu_type;
 	uint16_t unparsed_pdu_size;
+	Bool_t is_fragment;
 
 #ifdef OBJSHARE_PROTOCOL_HOST
 	OperationResult_t operation_result = OPERATION_RESULT_SUCCESS;
@@ -184,18 +340,32 @@ void packetManagerEventHandler(PacketManager_Event_t event, uint16_t unparsedPdu
 	uint8_t obj_id = 0;
 #endif
 
-	// Parse pdu type.
+	// Parse pdu type and sequence.
 	unparsed_pdu_size = PacketManager_ParseField((uint8_t *)&pdu_type,
 												 sizeof(pdu_type), unparsedPduSize);
+	unparsed_pdu_size = PacketManager_ParseField(&RxPduSequence, sizeof(RxPduSequence),
+												 unparsed_pdu_size);
+
+	is_fragment = (pdu_type & OBJSHARE_PROTOCOL_PDUTYPE_FRAGMENT_FLAG) ? TRUE : FALSE;
+	pdu_type &= ~OBJSHARE_PROTOCOL_PDUTYPE_FRAGMENT_FLAG;
 
 	switch (pdu_type)
 	{
 #ifdef OBJSHARE_PROTOCOL_HOST
 	case OBJSHARE_PROTOCOL_PDUTYPE_WRITE_RESP:
 	case OBJSHARE_PROTOCOL_PDUTYPE_READ_RESP:
+	case OBJSHARE_PROTOCOL_PDUTYPE_READ_MULTI_RESP:
+	case OBJSHARE_PROTOCOL_PDUTYPE_WRITE_MULTI_RESP:
+	case OBJSHARE_PROTOCOL_PDUTYPE_SUBSCRIBE_RESP:
+	case OBJSHARE_PROTOCOL_PDUTYPE_NOTIFY:
+	case OBJSHARE_PROTOCOL_PDUTYPE_READ_RANGE_RESP:
+	case OBJSHARE_PROTOCOL_PDUTYPE_WRITE_RANGE_RESP:
+	case OBJSHARE_PROTOCOL_PDUTYPE_READ_DELTA_RESP:
+	case OBJSHARE_PROTOCOL_PDUTYPE_READ_IF_CHANGED_RESP:
+	case OBJSHARE_PROTOCOL_PDUTYPE_GET_CHANGES_RESP:
 	{
 		unparsed_pdu_size = PacketManager_ParseField((uint8_t *)&operation_result,
-													 sizeof(operation_result), unparsedPduSize);
+													 sizeof(operation_result), unparsed_pdu_size);
 	}
 	break;
 
@@ -204,12 +374,21 @@ void packetManagerEventHandler(PacketManager_Event_t event, uint16_t unparsedPdu
 #else
 	case OBJSHARE_PROTOCOL_PDUTYPE_READ_REQ:
 	case OBJSHARE_PROTOCOL_PDUTYPE_WRITE_REQ:
+	case OBJSHARE_PROTOCOL_PDUTYPE_WRITE_MULTI_REQ:
+	case OBJSHARE_PROTOCOL_PDUTYPE_WRITE_BROADCAST_REQ:
+	case OBJSHARE_PROTOCOL_PDUTYPE_SUBSCRIBE_REQ:
+	case OBJSHARE_PROTOCOL_PDUTYPE_READ_RANGE_REQ:
+	case OBJSHARE_PROTOCOL_PDUTYPE_WRITE_RANGE_REQ:
+	case OBJSHARE_PROTOCOL_PDUTYPE_READ_DELTA_REQ:
+	case OBJSHARE_PROTOCOL_PDUTYPE_READ_IF_CHANGED_REQ:
 	{
-		unparsed_pdu_size = PacketManager_ParseField(&obj_id, sizeof(obj_id), unparsedPduSize);
+		unparsed_pdu_size = PacketManager_ParseField(&obj_id, sizeof(obj_id), unparsed_pdu_size);
 	}
 	break;
 
 	case OBJSHARE_PROTOCOL_PDUTYPE_POLL_REQ:
+	case OBJSHARE_PROTOCOL_PDUTYPE_READ_MULTI_REQ:
+	case OBJSHARE_PROTOCOL_PDUTYPE_GET_CHANGES_REQ:
 	break;
 #endif
 
@@ -217,9 +396,120 @@ void packetManagerEventHandler(PacketManager_Event_t event, uint16_t unparsedPdu
 		break;
 	}
 
+	RxDataOffset = 0;
+	RxLastFragment = TRUE;
+
+	if (is_fragment)
+	{
+		uint8_t fragment_header[OBJSHARE_PROTOCOL_FRAGMENT_HEADER_SIZE];
+
+		unparsed_pdu_size = PacketManager_ParseField(fragment_header, sizeof(fragment_header),
+													 unparsed_pdu_size);
+
+		uint16_t data_length = (uint16_t)fragment_header[2] | ((uint16_t)fragment_header[3] << 8);
+
+		if (!fragment_header[0])
+		{
+			RxNextSequence = 0;
+			RxFragmentCount = fragment_header[1];
+			RxFragmentDataLength = data_length;
+		}
+
+		// A gap drops the rest of the fragments; the request is repeated as a whole.
+		if ((fragment_header[0] != RxNextSequence) || (fragment_header[1] != RxFragmentCount) ||
+			(data_length != RxFragmentDataLength))
+		{
+			RxFragmentCount = 0;
+			return;
+		}
+
+		RxDataLength = RxFragmentDataLength;
+		RxDataOffset = (uint16_t)RxNextSequence * OBJSHARE_PROTOCOL_MAX_FRAGMENT_SIZE;
+		RxLastFragment = (++RxNextSequence == RxFragmentCount) ? TRUE : FALSE;
+	}
+	else
+	{
+		RxDataLength = unparsed_pdu_size;
+	}
+
 #ifdef OBJSHARE_PROTOCOL_HOST
 	PduReceivedDelegate(pdu_type, operation_result, unparsed_pdu_size);
 #else
 	PduReceivedDelegate(pdu_type, obj_id, unparsed_pdu_size);
 #endif
-}
\ No newline at end of file
+}
+
+static void switchDirection(ObjshareProtocol_Direction_t direction)
+{
+	TRACE(TRACE_EVENT_DIRECTION_SWITCH, direction, 0);
+
+	SwitchDirectionDelegate ? SwitchDirectionDelegate(direction) : (void)0;
+}
+
+static void sendFragments(void)
+{
+	while (TxFragmentation.sequence < TxFragmentation.count)
+	{
+		PacketManager_PduField_t pdu_fields[2];
+		uint8_t pdu_header[3 + OBJSHARE_PROTOCOL_FRAGMENT_HEADER_SIZE] = {
+			TxFragmentation.pduType | OBJSHARE_PROTOCOL_PDUTYPE_FRAGMENT_FLAG,
+			TxFragmentation.pduSequence, TxFragmentation.argument,
+			TxFragmentation.sequence, TxFragmentation.count,
+			(uint8_t)TxFragmentation.dataLength, (uint8_t)(TxFragmentation.dataLength >> 8)};
+		uint16_t offset = (uint16_t)TxFragmentation.sequence * OBJSHARE_PROTOCOL_MAX_FRAGMENT_SIZE;
+		uint16_t length = TxFragmentation.dataLength - offset;
+
+		length = (length > OBJSHARE_PROTOCOL_MAX_FRAGMENT_SIZE) ? OBJSHARE_PROTOCOL_MAX_FRAGMENT_SIZE
+																: length;
+
+		// Type, sequence, argument and fragment header go in one field.
+		pdu_fields[0].data = pdu_header;
+		pdu_fields[0].length = sizeof(pdu_header);
+		pdu_fields[1].data = &TxFragmentation.data[offset];
+		pdu_fields[1].length = length;
+
+		// Transmission queue is full; continue as frames go out.
+		if (!PacketManager_Send(pdu_fields, 2))
+		{
+			break;
+		}
+
+		TxFragmentation.sequence++;
+	}
+}
+
+#if defined(OBJSHARE_PROTOCOL_PERIPHERAL) && defined(PACKET_MANAGER_STREAM)
+// Asks the upper layer where the data of a write or broadcast write request goes, once the sequence, the object id
+//and the fragment header are decoded. Frame is not validated yet; sink is only written into.
+static uint16_t streamEventHandler(uint8_t *header, uint16_t headerLength,
+								   PacketManager_PduField_t *sink)
+{
+	ObjshareProtocol_PduType_t pdu_type = header[0] & ~OBJSHARE_PROTOCOL_PDUTYPE_FRAGMENT_FLAG;
+	Bool_t is_fragment = (header[0] & OBJSHARE_PROTOCOL_PDUTYPE_FRAGMENT_FLAG) ? TRUE : FALSE;
+
+	// Type, sequence, object id and fragment header if any.
+	uint16_t header_length = is_fragment ? (3 + OBJSHARE_PROTOCOL_FRAGMENT_HEADER_SIZE) : 3;
+	uint16_t offset = 0;
+
+	if (((pdu_type != OBJSHARE_PROTOCOL_PDUTYPE_WRITE_REQ) &&
+		 (pdu_type != OBJSHARE_PROTOCOL_PDUTYPE_WRITE_BROADCAST_REQ)) ||
+		!PduDataSinkDelegate)
+	{
+		return 0;
+	}
+
+	if (headerLength < header_length)
+	{
+		return header_length;
+	}
+
+	if (is_fragment)
+	{
+		offset = (uint16_t)header[3] * OBJSHARE_PROTOCOL_MAX_FRAGMENT_SIZE;
+	}
+
+	sink->data = PduDataSinkDelegate(header[2], offset, &sink->length);
+
+	return 0;
+}
+#endif
@@ -13,6 +13,39 @@ extern "C"
 {
 #endif
 	/* Exported definitions -----------------------------------------------------*/
+#define PACKET_MANAGER_TX_QUEUE_LENGTH 4
+#define PACKET_MANAGER_TX_CHUNK_SIZE 32
+#define PACKET_MANAGER_MAX_PDU_FIELD_COUNT 4
+#define PACKET_MANAGER_FRAME_HEADER_SIZE 8
+
+// Largest frame the receiver collects, crc included; independent of the serial ring size.
+#ifndef PACKET_MANAGER_MAX_FRAME_SIZE
+#define PACKET_MANAGER_MAX_FRAME_SIZE 256
+#endif
+
+// Frames are checked with CRC32C instead of CCITT CRC16; both ends must agree.
+//#define PACKET_MANAGER_CRC32C
+
+// Frames are COBS encoded and delimited by zero instead of escaped; both ends must agree.
+//#define PACKET_MANAGER_COBS
+
+// Escaped frames carry their length after the start character and the body is sent as is, so
+//the receiver copies it in bulk; start character is still hunted for to synchronize.
+//#define PACKET_MANAGER_LENGTH_HEADER
+
+// Escaped frames may be decoded past their leading fields straight into a buffer given by the
+//stream delegate, so that large pdus need not fit into the inbox; escape framing only.
+//#define PACKET_MANAGER_STREAM
+
+// Link counters, read with PacketManager_GetStats; compiled out unless defined.
+//#define PACKET_MANAGER_STATS
+
+#ifdef PACKET_MANAGER_CRC32C
+#define PACKET_MANAGER_FRAME_CRC_SIZE 4
+#else
+#define PACKET_MANAGER_FRAME_CRC_SIZE 2
+#endif
+
 	/* Exported types ------------------------------------------------------------*/
 	enum
 	{
@@ -37,8 +70,25 @@ extern "C"
 		uint16_t length;
 	} PacketManager_PduField_t;
 
+	// Free running link counters; they wrap around.
+	typedef struct
+	{
+		uint32_t rxFrames;	  // Frames validated and passed up.
+		uint32_t rxCrcErrors; // Frames failing the check, too short or malformed.
+		uint32_t rxOverflows; // Frames dropped for not fitting into the inbox.
+		uint32_t rxEscapes;	  // Escape sequences decoded.
+		uint32_t txFrames;	  // Frames completely encoded.
+		uint32_t txQueueFull; // Sends refused for a full tx queue.
+		uint32_t txEscapes;	  // Escape sequences encoded.
+	} PacketManager_Stats_t;
+
 	typedef void (*PacketManager_EventOccurredDelegate_t)(PacketManager_Event_t event, uint16_t rawSize);
 
+	// Called with the decoded leading bytes of a frame. Returns the header length it needs if
+	//more, else 0; setting sink redirects the rest of the frame, crc included, into it.
+	typedef uint16_t (*PacketManager_StreamDelegate_t)(uint8_t *header, uint16_t headerLength,
+													   PacketManager_PduField_t *sink);
+
 	/* Exported functions --------------------------------------------------------*/
 	/***
   * @Brief      Setup function for UART controller module.
@@ -63,12 +113,16 @@ extern "C"
 	extern void PacketManager_Stop(void);
 
 	/***
-  * @Brief      Encodes and frames PDU then pushes to the TX buffer.
+  * @Brief      Pushes PDU to the TX queue; it is encoded and framed while being transmitted.
+  *             Fields longer than the space left in PACKET_MANAGER_FRAME_HEADER_SIZE are not
+  *             copied and have to stay valid until the transmission is completed.
   *
   * @Params     pduFields-> Pointer to the PDU fields.
   *             pduFieldCount-> Number of PDU fields.
+  *
+	* @Return			FALSE if the TX queue is full or the module is not operating.
   */
-	extern void PacketManager_Send(PacketManager_PduField_t *pduFields, uint8_t pduFieldCount);
+	extern Bool_t PacketManager_Send(PacketManager_PduField_t *pduFields, uint8_t pduFieldCount);
 
 	/***
   * @Brief      Decodes pdu field.
@@ -81,12 +135,56 @@ extern "C"
   */
 	extern uint16_t PacketManager_ParseField(uint8_t *data, uint16_t length, uint16_t unparsedPduSize);
 
+	/***
+  * @Brief      Gives pdu field in place, without copying. Field points into the validated
+  *             frame and stays valid until the pdu received event handler returns.
+  *
+	* @Params     field-> Field to be set; its length is at most the given length.
+	*							length-> Length of the PDU field data.
+	*							unparsedPduSize-> Remaining portion of the pdu that is unparsed.
+  *
+	* @Return			Unparsed pdu size updated.
+  */
+	extern uint16_t PacketManager_ViewField(PacketManager_PduField_t *field, uint16_t length,
+											uint16_t unparsedPduSize);
+
+#ifdef PACKET_MANAGER_STREAM
+	/***
+  * @Brief      Sets the delegate which decides where the rest of a received frame goes. Sink
+  *             is parsed in place of the inbox once the frame is validated. Frame overflowing
+  *             the sink is still validated and given in full length, but its data past the sink
+  *             is not kept; the upper layer refuses it by its length.
+  *
+  * @Params     streamHandler-> Stream delegate; 0 keeps every frame in the inbox.
+  */
+	extern void PacketManager_SetStreamDelegate(PacketManager_StreamDelegate_t streamHandler);
+#endif
+
+#ifdef PACKET_MANAGER_STATS
+	/***
+  * @Brief      Copies the link counters. Counters updated from the interrupt are taken at the
+  *             same moment as the rest; call from the main loop.
+  *
+  * @Params     stats-> Snapshot to be filled.
+  */
+	extern void PacketManager_GetStats(PacketManager_Stats_t *stats);
+#endif
+
 	/***
   * @Brief      Handles module errors. Recovers not corrupted messages and clears the
   *             hardware errors.
   */
 	extern void PacketManager_ErrorHandler(void);
 
+#ifdef PACKET_MANAGER_TEST
+	/***
+  * @Brief      Feeds frames straddling the receive ring's wrap point to the decoder.
+  *
+	* @Return			TRUE if every frame is received intact.
+  */
+	extern Bool_t PacketManager_Test(void);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -21,8 +21,10 @@
 #define PRP_PID_I_COEFF_OBJ_ID 7
 #define PRP_PID_K_COEFF_OBJ_ID 8
 #define PRP_PID_D_COEFF_OBJ_ID 9
+#define PRP_CALIBRATION_TABLE_OBJ_ID 10
 
 #define PRP_MAX_NAME_LENGTH 32
+#define PRP_CALIBRATION_TABLE_LENGTH 256
 
 /* Typedefs ----------------------------------------------------------------*/
 typedef enum
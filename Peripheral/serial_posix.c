@@ -0,0 +1,364 @@
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 600
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include "serial.h"
+#include "trace.h"
+
+#define RING_BUFFER_MASK (SERIAL_RING_BUFFER_SIZE - 1)
+
+#ifdef SERIAL_STATS
+#define STATS_ADD(counter, value) (Stats.counter += (value))
+#else
+#define STATS_ADD(counter, value) ((void)0)
+#endif
+
+/* Private function prototypes ---------------------------------------------*/
+static Bool_t openPort(void);
+static uint16_t receive(void);
+static void notifyDataReady(uint16_t size);
+static void transmit(void);
+static Bool_t requestTxData(void);
+#ifdef SERIAL_TEST
+static void testEventHandler(Serial_Event_t event, Serial_Span_t *spans, uint8_t spanCount);
+#endif
+
+/* Private variables -------------------------------------------------------*/
+// Receive buffer. BufferWriteIdx stands in for the DMA producer position.
+static uint8_t Buffer[SERIAL_RING_BUFFER_SIZE];
+static uint16_t BufferReadIdx;
+static uint16_t BufferWriteIdx;
+
+// Transmit buffer which is being written to the port.
+static uint8_t *TxData;
+static uint16_t TxLength;
+
+// Flags.
+static Bool_t TxIdle;
+static Bool_t TxCompleted;
+static Bool_t RestartReceive;
+
+// Port.
+static const char *DevicePath = SERIAL_POSIX_DEFAULT_DEVICE;
+static int Fd = -1;
+
+// Delegates.
+static Serial_EventOccurredDelegate_t EventOccurredDelegate;
+static Serial_TxDataRequestDelegate_t TxDataRequestDelegate;
+
+#ifdef SERIAL_STATS
+// Everything runs in the main loop; no interrupt to race with.
+static Serial_Stats_t Stats;
+#endif
+
+#ifdef SERIAL_TEST
+// Bytes given by the data ready events, and whether they came in the order written.
+static uint8_t TestNextValue;
+static uint16_t TestReceivedCount;
+static Bool_t TestMismatch;
+#endif
+
+/* Exported functions ------------------------------------------------------*/
+void Serial_Setup(Serial_EventOccurredDelegate_t eventHandler,
+		Serial_TxDataRequestDelegate_t txDataRequestHandler) {
+	EventOccurredDelegate = eventHandler;
+	TxDataRequestDelegate = txDataRequestHandler;
+}
+
+void Serial_SetDevice(const char *path) {
+	DevicePath = path;
+}
+
+const char *Serial_GetPtyName(void) {
+	if ((Fd < 0) || strcmp(DevicePath, SERIAL_POSIX_PTY_MASTER)) {
+		return 0;
+	}
+
+	return ptsname(Fd);
+}
+
+Bool_t Serial_Start(void) {
+	// Initialize flags.
+	TxIdle = TRUE;
+	TxCompleted = FALSE;
+	RestartReceive = FALSE;
+	TxLength = 0;
+
+	// Initialize buffer.
+	BufferReadIdx = 0;
+	BufferWriteIdx = 0;
+
+	return openPort();
+}
+
+void Serial_Execute(void) {
+	uint16_t size;
+
+	// Move whatever the port holds into the ring, as the DMA would do.
+	size = receive();
+
+	// Continue a transmission which the port could not take at once.
+	transmit();
+
+	// Transmission ended before anything received with it could be answered; report it first.
+	if (TxCompleted)
+	{
+		EventOccurredDelegate ? EventOccurredDelegate(SERIAL_EVENT_TX_COMPLETED, 0, 0) : (void)0;
+		TxCompleted = FALSE;
+	}
+
+	// If there are any element in the buffer, call the delegate function.
+	if (size) {
+		STATS_ADD(rxBytes, size);
+		TRACE(TRACE_EVENT_RX_DATA, 0, size);
+		notifyDataReady(size);
+	}
+
+	// If some error occurred; reopen the port.
+	if (RestartReceive) {
+		RestartReceive = FALSE;
+		BufferReadIdx = BufferWriteIdx;
+		STATS_ADD(restarts, 1);
+
+		if (!openPort()) {
+			EventOccurredDelegate ?
+					EventOccurredDelegate(SERIAL_EVENT_ERROR_OCCURRED, 0, 0) :
+					(void) 0;
+		}
+	}
+}
+
+void Serial_Stop(void) {
+	if (Fd >= 0) {
+		close(Fd);
+		Fd = -1;
+	}
+}
+
+void Serial_Transmit(void) {
+	// A write is in progress; it picks up the data when the kernel has taken the current one.
+	if (!TxIdle || !requestTxData()) {
+		return;
+	}
+
+	TxIdle = FALSE;
+	transmit();
+}
+
+#ifdef SERIAL_STATS
+void Serial_GetStats(Serial_Stats_t *stats) {
+	*stats = Stats;
+}
+#endif
+
+/* Private functions -------------------------------------------------------*/
+static Bool_t openPort(void) {
+	struct termios tio;
+
+	Serial_Stop();
+
+	Fd = open(DevicePath, O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (Fd < 0) {
+		return FALSE;
+	}
+
+	// Pseudo-terminal master; make the slave side available.
+	if (!strcmp(DevicePath, SERIAL_POSIX_PTY_MASTER)) {
+		if (grantpt(Fd) || unlockpt(Fd)) {
+			Serial_Stop();
+			return FALSE;
+		}
+	}
+
+	// Raw 8N1, no line discipline; framing characters must pass untouched.
+	if (tcgetattr(Fd, &tio) == 0) {
+		cfmakeraw(&tio);
+		cfsetispeed(&tio, SERIAL_POSIX_BAUDRATE);
+		cfsetospeed(&tio, SERIAL_POSIX_BAUDRATE);
+		tio.c_cflag |= CLOCAL | CREAD;
+		tio.c_cc[VMIN] = 0;
+		tio.c_cc[VTIME] = 0;
+
+		if (tcsetattr(Fd, TCSANOW, &tio)) {
+			Serial_Stop();
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static uint16_t receive(void) {
+	// Consumer empties the ring on every execute, so the whole of it may be filled; as the DMA
+	//may do between two executes.
+	uint16_t size = 0;
+	uint16_t free_space = SERIAL_RING_BUFFER_SIZE;
+
+	while (free_space) {
+		uint16_t span = SERIAL_RING_BUFFER_SIZE - BufferWriteIdx;
+		span = (free_space < span) ? free_space : span;
+
+		ssize_t count = read(Fd, &Buffer[BufferWriteIdx], span);
+
+		if (count <= 0) {
+			// A pty master reports EIO until the slave side is opened.
+			if ((count < 0) && (errno != EAGAIN) && (errno != EINTR) && (errno != EIO)) {
+				RestartReceive = TRUE;
+				STATS_ADD(errors, 1);
+			}
+			break;
+		}
+
+		BufferWriteIdx = (BufferWriteIdx + count) & RING_BUFFER_MASK;
+		free_space -= count;
+		size += count;
+
+		if (count < span) {
+			break;
+		}
+	}
+
+	return size;
+}
+
+static void transmit(void) {
+	while (!TxIdle) {
+		// Chunk is handed to the kernel; same as DMA transfer complete, chain the next one.
+		if (!TxLength && !requestTxData()) {
+			TxCompleted = TRUE;
+			TxIdle = TRUE;
+			TRACE(TRACE_EVENT_TX_DONE, 0, 0);
+			break;
+		}
+
+		ssize_t count = write(Fd, TxData, TxLength);
+
+		if (count <= 0) {
+			if ((count < 0) && (errno != EAGAIN) && (errno != EINTR)) {
+				RestartReceive = TRUE;
+				STATS_ADD(errors, 1);
+			}
+			break;
+		}
+
+		TxData += count;
+		TxLength -= count;
+		STATS_ADD(txBytes, count);
+	}
+}
+
+static Bool_t requestTxData(void) {
+	Serial_Span_t span;
+	span.data = 0;
+	span.length = 0;
+
+	TxDataRequestDelegate ? TxDataRequestDelegate(&span) : (void) 0;
+
+	TxData = span.data;
+	TxLength = span.length;
+
+	return (TxLength ? TRUE : FALSE);
+}
+
+static void notifyDataReady(uint16_t size) {
+	Serial_Span_t spans[2];
+	uint8_t span_count = 1;
+	uint16_t tail_size = SERIAL_RING_BUFFER_SIZE - BufferReadIdx;
+
+	spans[0].data = &Buffer[BufferReadIdx];
+
+	if (size <= tail_size) {
+		spans[0].length = size;
+	} else {
+		// Data wraps around; the rest starts at the beginning of the ring. A full ring ends
+		//where it starts.
+		spans[0].length = tail_size;
+		spans[1].data = Buffer;
+		spans[1].length = size - tail_size;
+		span_count++;
+	}
+
+	EventOccurredDelegate ?
+			EventOccurredDelegate(SERIAL_EVENT_DATA_READY, spans, span_count) :
+			(void) 0;
+
+	BufferReadIdx = (BufferReadIdx + size) & RING_BUFFER_MASK;
+}
+
+#ifdef SERIAL_TEST
+// Writes a ring and a byte more to a pipe standing in for the port, from every start position of
+//the ring, and checks the two executes give the ring in one or two spans and then the byte.
+Bool_t Serial_Test(void) {
+	Serial_EventOccurredDelegate_t event_occurred_delegate = EventOccurredDelegate;
+	int fd = Fd;
+	int pipe_fds[2];
+	uint8_t data[SERIAL_RING_BUFFER_SIZE + 1];
+	Bool_t result = TRUE;
+
+	if (pipe(pipe_fds) || fcntl(pipe_fds[0], F_SETFL, O_NONBLOCK)) {
+		return FALSE;
+	}
+
+	EventOccurredDelegate = testEventHandler;
+	Fd = pipe_fds[0];
+	TxIdle = TRUE;
+	TxCompleted = FALSE;
+
+	for (uint16_t offset = 0; (offset < SERIAL_RING_BUFFER_SIZE) && result; offset++) {
+		BufferReadIdx = offset;
+		BufferWriteIdx = offset;
+		TestNextValue = (uint8_t) offset;
+		TestMismatch = FALSE;
+
+		for (uint16_t i = 0; i < sizeof(data); i++) {
+			data[i] = (uint8_t) (offset + i);
+		}
+
+		if (write(pipe_fds[1], data, sizeof(data)) != sizeof(data)) {
+			result = FALSE;
+			break;
+		}
+
+		TestReceivedCount = 0;
+		Serial_Execute();
+		result = (TestReceivedCount == SERIAL_RING_BUFFER_SIZE) ? result : FALSE;
+
+		TestReceivedCount = 0;
+		Serial_Execute();
+		result = ((TestReceivedCount == 1) && !TestMismatch) ? result : FALSE;
+	}
+
+	close(pipe_fds[0]);
+	close(pipe_fds[1]);
+
+	EventOccurredDelegate = event_occurred_delegate;
+	Fd = fd;
+
+	return result;
+}
+
+static void testEventHandler(Serial_Event_t event, Serial_Span_t *spans, uint8_t spanCount) {
+	if (event != SERIAL_EVENT_DATA_READY) {
+		return;
+	}
+
+	// Second span exists only when the data wraps, and then starts the ring.
+	if ((spanCount > 1) && ((spans[1].data != Buffer) || !spans[1].length
+			|| (&spans[0].data[spans[0].length] != &Buffer[SERIAL_RING_BUFFER_SIZE]))) {
+		TestMismatch = TRUE;
+	}
+
+	for (uint8_t i = 0; i < spanCount; i++) {
+		for (uint16_t j = 0; j < spans[i].length; j++) {
+			TestMismatch = (spans[i].data[j] != TestNextValue++) ? TRUE : TestMismatch;
+		}
+
+		TestReceivedCount += spans[i].length;
+	}
+}
+#endif
@@ -5,3 +5,30 @@ uint32_t SysTime_GetTimeInMs(void)
 {
     return HAL_GetTick();
 }
+
+uint32_t SysTime_GetTimeInUs(void)
+{
+    uint32_t tick;
+    uint32_t counter;
+    Bool_t is_pending;
+
+    // SysTick counts down from its reload value each millisecond; read again if the tick
+    //advanced in between.
+    do
+    {
+        tick = HAL_GetTick();
+        counter = SysTick->VAL;
+        is_pending = (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) ? TRUE : FALSE;
+    } while (tick != HAL_GetTick());
+
+    // Counter reloaded but the SysTick interrupt could not run yet, as in an interrupt of the
+    //same or higher priority; the tick is one behind. Counter is read again, it may have been
+    //read before the reload.
+    if (is_pending)
+    {
+        counter = SysTick->VAL;
+        tick++;
+    }
+
+    return (tick * 1000U) + ((SysTick->LOAD - counter) / (SystemCoreClock / 1000000U));
+}
@@ -0,0 +1,50 @@
+#include "trace.h"
+#include "sys_time.h"
+
+#if (TRACE_RING_LENGTH & (TRACE_RING_LENGTH - 1))
+#error "TRACE_RING_LENGTH must be a power of two"
+#endif
+
+#ifdef TRACE_ENABLE
+/* Private variables -------------------------------------------------------*/
+// Writers claim a record by advancing the head and fill it in afterwards; a record being
+//written while the ring is dumped may be torn.
+static Trace_Record_t Ring[TRACE_RING_LENGTH];
+static volatile uint32_t Head;
+
+/* Exported functions ------------------------------------------------------*/
+void Trace_Record(Trace_Event_t event, uint8_t arg8, uint16_t arg16)
+{
+#if defined(__ARM_ARCH_6M__)
+	// No exclusive access on ARMv6-M; an interrupt in between may overwrite this record.
+	uint32_t idx = Head++;
+#else
+	uint32_t idx = __atomic_fetch_add(&Head, 1, __ATOMIC_RELAXED);
+#endif
+	Trace_Record_t *record = &Ring[idx & (TRACE_RING_LENGTH - 1)];
+
+	record->timestamp = SysTime_GetTimeInUs();
+	record->event = event;
+	record->arg8 = arg8;
+	record->arg16 = arg16;
+}
+
+const Trace_Record_t *Trace_GetRing(Trace_DumpHeader_t *header)
+{
+	header->magic = TRACE_DUMP_MAGIC;
+	header->head = Head;
+	header->length = TRACE_RING_LENGTH;
+
+	return Ring;
+}
+#else
+const Trace_Record_t *Trace_GetRing(Trace_DumpHeader_t *header)
+{
+	// Built without trace points; there is no ring.
+	header->magic = TRACE_DUMP_MAGIC;
+	header->head = 0;
+	header->length = 0;
+
+	return 0;
+}
+#endif
@@ -0,0 +1,126 @@
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "crc.h"
+
+/* Private constants ---------------------------------------------------------*/
+// Bytes processed per engine and frame size.
+#define BENCHMARK_VOLUME (64UL * 1024 * 1024)
+#define MAX_FRAME_SIZE 4096
+
+/* Private typedefs ----------------------------------------------------------*/
+typedef uint16_t (*Calculate16_t)(uint16_t seed, uint8_t *buff, uint16_t size);
+
+typedef struct
+{
+	const char *name;
+	Calculate16_t calculate;
+} Engine_t;
+
+/* Private function declarations ---------------------------------------------*/
+static uint32_t calculate32C(uint16_t seed, uint8_t *buff, uint16_t size);
+static double getTimeInSec(void);
+
+/* Private variables ---------------------------------------------------------*/
+// Bitwise engine is the shift/xor implementation crc.c had before the table engines.
+static const Engine_t Engines[] = {
+	{"bitwise", CRC_Calculate16Bitwise},
+#if (CRC_ENGINE >= CRC_ENGINE_TABLE)
+	{"table", CRC_Calculate16Table},
+#endif
+#if (CRC_ENGINE >= CRC_ENGINE_SLICE_BY_4)
+	{"slice-by-4", CRC_Calculate16SliceBy4},
+#endif
+#if (CRC_ENGINE >= CRC_ENGINE_SLICE_BY_8)
+	{"slice-by-8", CRC_Calculate16SliceBy8},
+#endif
+};
+
+static const uint16_t FrameSizes[] = {16, 64, 256, MAX_FRAME_SIZE};
+
+static uint8_t Frame[MAX_FRAME_SIZE];
+
+/* Public function implementations. ------------------------------------------*/
+// Checks that every CRC16 engine gives the same result and prints their throughput, and that
+//of CRC32C, for a few frame sizes.
+int main(void)
+{
+	for (uint16_t i = 0; i < MAX_FRAME_SIZE; i++)
+	{
+		Frame[i] = (uint8_t)rand();
+	}
+
+	// "123456789" check values.
+	uint8_t check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+
+	if ((CRC_Calculate16(0xFFFF, check, sizeof(check)) != 0x29B1) ||
+		(CRC_Calculate8(0x00, check, sizeof(check)) != 0x02) || (CRC_Calculate8(0xFF, check, sizeof(check)) != 0x13) ||
+		((CRC_Calculate32C(0xFFFFFFFFUL, check, sizeof(check)) ^ 0xFFFFFFFFUL) != 0xE3069283UL))
+	{
+		fprintf(stderr, "check value mismatch\n");
+		return EXIT_FAILURE;
+	}
+
+	for (uint8_t e = 1; e < (sizeof(Engines) / sizeof(Engines[0])); e++)
+	{
+		for (uint16_t size = 0; size <= MAX_FRAME_SIZE; size += 7)
+		{
+			if (Engines[e].calculate(0xFFFF, Frame, size) != CRC_Calculate16Bitwise(0xFFFF, Frame, size))
+			{
+				fprintf(stderr, "%s engine mismatch at %u bytes\n", Engines[e].name, (unsigned)size);
+				return EXIT_FAILURE;
+			}
+		}
+	}
+
+	printf("%-12s", "MB/s");
+	for (uint8_t s = 0; s < (sizeof(FrameSizes) / sizeof(FrameSizes[0])); s++)
+	{
+		printf("%10u B", (unsigned)FrameSizes[s]);
+	}
+	printf("\n");
+
+	for (uint8_t e = 0; e <= (sizeof(Engines) / sizeof(Engines[0])); e++)
+	{
+		Bool_t is_crc32c = (e == (sizeof(Engines) / sizeof(Engines[0])));
+
+		printf("%-12s", is_crc32c ? "crc32c" : Engines[e].name);
+
+		for (uint8_t s = 0; s < (sizeof(FrameSizes) / sizeof(FrameSizes[0])); s++)
+		{
+			uint16_t size = FrameSizes[s];
+			uint32_t iterations = BENCHMARK_VOLUME / size;
+			volatile uint32_t sink = 0;
+			double start = getTimeInSec();
+
+			for (uint32_t i = 0; i < iterations; i++)
+			{
+				sink += is_crc32c ? calculate32C((uint16_t)i, Frame, size)
+								  : Engines[e].calculate((uint16_t)i, Frame, size);
+			}
+
+			double elapsed = getTimeInSec() - start;
+
+			printf("%12.0f", (double)iterations * size / elapsed / 1e6);
+		}
+		printf("\n");
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/* Private function implementations ------------------------------------------*/
+static uint32_t calculate32C(uint16_t seed, uint8_t *buff, uint16_t size)
+{
+	return CRC_Calculate32C(seed, buff, size);
+}
+
+static double getTimeInSec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (double)ts.tv_sec + ((double)ts.tv_nsec / 1e9);
+}
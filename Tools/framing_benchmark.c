@@ -0,0 +1,220 @@
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "serial.h"
+#include "packet_manager.h"
+
+/* Private constants ---------------------------------------------------------*/
+// Built once per framing scheme; see the benchmark target of the Makefile.
+#if defined(PACKET_MANAGER_COBS)
+#define FRAMING_NAME "cobs"
+#elif defined(PACKET_MANAGER_LENGTH_HEADER)
+#define FRAMING_NAME "length"
+#else
+#define FRAMING_NAME "escape"
+#endif
+
+#define PAYLOAD_SIZE 96
+#define FRAME_COUNT 1000
+#define PASS_COUNT 200
+#define MAX_WIRE_SIZE (FRAME_COUNT * SERIAL_RING_BUFFER_SIZE)
+
+/* Private typedefs ----------------------------------------------------------*/
+typedef void (*PayloadGenerator_t)(uint8_t *payload, uint32_t seed);
+
+typedef struct
+{
+	const char *name;
+	PayloadGenerator_t generate;
+} Workload_t;
+
+/* Private function declarations ---------------------------------------------*/
+static void generateRandom(uint8_t *payload, uint32_t seed);
+static void generateFloats(uint8_t *payload, uint32_t seed);
+static void generateSpecials(uint8_t *payload, uint32_t seed);
+static void pduReceivedEventHandler(PacketManager_Event_t event, uint16_t unparsedPduSize);
+static double getTimeInSec(void);
+
+/* Private variables ---------------------------------------------------------*/
+static const Workload_t Workloads[] = {
+	{"random", generateRandom},
+	{"float", generateFloats},
+	{"specials", generateSpecials},
+};
+
+static uint8_t Payloads[FRAME_COUNT][PAYLOAD_SIZE];
+static uint8_t Wire[MAX_WIRE_SIZE];
+static uint32_t ReceivedCount;
+static Bool_t Mismatch;
+
+// Serial layer stand-in; the benchmark pulls the chunks and pushes the received data itself.
+static Serial_EventOccurredDelegate_t SerialEventOccurredDelegate;
+static Serial_TxDataRequestDelegate_t SerialTxDataRequestDelegate;
+
+/* Public function implementations. ------------------------------------------*/
+// Measures wire overhead, encode and decode cost of the compiled framing scheme.
+int main(void)
+{
+	PacketManager_Setup(pduReceivedEventHandler);
+	PacketManager_Start();
+
+	printf("%-8s %-9s %12s %10s %14s %14s\n", "framing", "payload", "wire bytes",
+		   "overhead", "encode ns/B", "decode ns/B");
+
+	for (uint8_t w = 0; w < (sizeof(Workloads) / sizeof(Workloads[0])); w++)
+	{
+		uint32_t wire_length = 0;
+		double encode_time = 0;
+		double decode_time = 0;
+
+		for (uint16_t i = 0; i < FRAME_COUNT; i++)
+		{
+			Workloads[w].generate(Payloads[i], i);
+		}
+
+		ReceivedCount = 0;
+		Mismatch = FALSE;
+
+		for (uint16_t pass = 0; pass < PASS_COUNT; pass++)
+		{
+			double start = getTimeInSec();
+
+			wire_length = 0;
+
+			for (uint16_t i = 0; i < FRAME_COUNT; i++)
+			{
+				PacketManager_PduField_t field = {Payloads[i], PAYLOAD_SIZE};
+				Serial_Span_t span;
+
+				PacketManager_Send(&field, 1);
+
+				do
+				{
+					span.data = 0;
+					span.length = 0;
+					SerialTxDataRequestDelegate(&span);
+
+					memcpy(&Wire[wire_length], span.data, span.length);
+					wire_length += span.length;
+				} while (span.length);
+			}
+
+			double middle = getTimeInSec();
+			Serial_Span_t span = {Wire, 0};
+
+			// Deliver the wire data in ring sized spans, as the serial layer does.
+			for (uint32_t i = 0; i < wire_length; i += span.length)
+			{
+				span.data = &Wire[i];
+				span.length = ((wire_length - i) < SERIAL_RING_BUFFER_SIZE) ? (wire_length - i)
+																			: SERIAL_RING_BUFFER_SIZE;
+				SerialEventOccurredDelegate(SERIAL_EVENT_DATA_READY, &span, 1);
+			}
+
+			encode_time += middle - start;
+			decode_time += getTimeInSec() - middle;
+		}
+
+		if (Mismatch || (ReceivedCount != (FRAME_COUNT * PASS_COUNT)))
+		{
+			fprintf(stderr, "%s payload: %u of %u frames received intact\n", Workloads[w].name,
+					(unsigned)ReceivedCount, (unsigned)(FRAME_COUNT * PASS_COUNT));
+			return EXIT_FAILURE;
+		}
+
+		double payload_bytes = (double)PAYLOAD_SIZE * FRAME_COUNT;
+
+		printf("%-8s %-9s %12.1f %9.1f%% %14.2f %14.2f\n", FRAMING_NAME, Workloads[w].name,
+			   wire_length / (double)FRAME_COUNT, ((wire_length / payload_bytes) - 1.0) * 100.0,
+			   encode_time * 1e9 / (payload_bytes * PASS_COUNT),
+			   decode_time * 1e9 / (payload_bytes * PASS_COUNT));
+	}
+
+	return EXIT_SUCCESS;
+}
+
+void Serial_Setup(Serial_EventOccurredDelegate_t eventHandler,
+				  Serial_TxDataRequestDelegate_t txDataRequestHandler)
+{
+	SerialEventOccurredDelegate = eventHandler;
+	SerialTxDataRequestDelegate = txDataRequestHandler;
+}
+
+Bool_t Serial_Start(void)
+{
+	return TRUE;
+}
+
+void Serial_Execute(void)
+{
+}
+
+void Serial_Stop(void)
+{
+}
+
+void Serial_Transmit(void)
+{
+}
+
+/* Private function implementations ------------------------------------------*/
+static void generateRandom(uint8_t *payload, uint32_t seed)
+{
+	for (uint16_t i = 0; i < PAYLOAD_SIZE; i++)
+	{
+		payload[i] = (uint8_t)rand();
+	}
+}
+
+// PID coefficients and set points; few distinct exponents, short mantissas.
+static void generateFloats(uint8_t *payload, uint32_t seed)
+{
+	for (uint16_t i = 0; i < (PAYLOAD_SIZE / sizeof(float)); i++)
+	{
+		float value = (float)((rand() % 20001) - 10000) / 100.0f;
+
+		memcpy(&payload[i * sizeof(float)], &value, sizeof(value));
+	}
+}
+
+// Worst case of escape framing.
+static void generateSpecials(uint8_t *payload, uint32_t seed)
+{
+	static const uint8_t specials[] = {0x0D, 0x3A, 0x3B};
+
+	for (uint16_t i = 0; i < PAYLOAD_SIZE; i++)
+	{
+		payload[i] = specials[(seed + i) % sizeof(specials)];
+	}
+}
+
+static void pduReceivedEventHandler(PacketManager_Event_t event, uint16_t unparsedPduSize)
+{
+	uint8_t payload[PAYLOAD_SIZE];
+
+	if ((event != PACKET_MANAGER_PDU_RECEIVED_EVENT) || (unparsedPduSize != PAYLOAD_SIZE))
+	{
+		Mismatch = TRUE;
+		return;
+	}
+
+	PacketManager_ParseField(payload, sizeof(payload), unparsedPduSize);
+
+	if (memcmp(payload, Payloads[ReceivedCount % FRAME_COUNT], PAYLOAD_SIZE))
+	{
+		Mismatch = TRUE;
+	}
+
+	ReceivedCount++;
+}
+
+static double getTimeInSec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (double)ts.tv_sec + ((double)ts.tv_nsec / 1e9);
+}
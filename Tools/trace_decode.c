@@ -0,0 +1,132 @@
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "trace.h"
+
+/* Private constants ---------------------------------------------------------*/
+// Direction values of the objshare protocol.
+#define DIRECTION_TX 0
+#define DIRECTION_RX 1
+
+/* Private variables ---------------------------------------------------------*/
+static const char *EventNames[TRACE_EVENT_COUNT] = {
+	[TRACE_EVENT_RX_DATA] = "rx data",
+	[TRACE_EVENT_TX_DONE] = "tx done",
+	[TRACE_EVENT_FRAME_START] = "frame start",
+	[TRACE_EVENT_FRAME_END] = "frame end",
+	[TRACE_EVENT_CRC_FAIL] = "crc fail",
+	[TRACE_EVENT_DIRECTION_SWITCH] = "direction",
+	[TRACE_EVENT_REQUEST_ENQUEUE] = "enqueue",
+	[TRACE_EVENT_REQUEST_DEQUEUE] = "dequeue",
+	[TRACE_EVENT_REQUEST_RESPONSE] = "response",
+	[TRACE_EVENT_REQUEST_TIMEOUT] = "timeout"};
+
+/* Public function implementations. ------------------------------------------*/
+// Prints a dumped trace ring as a timeline, oldest record first, with the time since the
+//previous record. Records further apart than the -g threshold are marked. Ends with the gaps
+//between switching to receive and the first byte received.
+int main(int argc, char **argv)
+{
+	uint32_t threshold = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "g:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'g':
+			threshold = (uint32_t)strtoul(optarg, 0, 0);
+			break;
+
+		default:
+			fprintf(stderr, "usage: %s [-g gap threshold in us] dump\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (optind >= argc)
+	{
+		fprintf(stderr, "usage: %s [-g gap threshold in us] dump\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	FILE *file = fopen(argv[optind], "rb");
+	Trace_DumpHeader_t header;
+
+	if (!file || (fread(&header, sizeof(header), 1, file) != 1) || (header.magic != TRACE_DUMP_MAGIC) ||
+		(header.length & (header.length - 1)))
+	{
+		fprintf(stderr, "%s is not a trace dump\n", argv[optind]);
+		return EXIT_FAILURE;
+	}
+
+	// Dumped by a build without trace points.
+	if (!header.length)
+	{
+		printf("0 records; dump of a build without TRACE_ENABLE\n");
+		return EXIT_SUCCESS;
+	}
+
+	Trace_Record_t *ring = malloc(header.length * sizeof(*ring));
+
+	if (!ring || (fread(ring, sizeof(*ring), header.length, file) != header.length))
+	{
+		fprintf(stderr, "%s is truncated\n", argv[optind]);
+		return EXIT_FAILURE;
+	}
+
+	fclose(file);
+
+	uint32_t count = (header.head < header.length) ? header.head : header.length;
+	uint32_t first = header.head - count;
+	uint32_t previous = 0;
+	uint32_t rx_switch = 0;
+	Bool_t rx_pending = FALSE;
+	uint32_t gap_count = 0;
+	uint32_t gap_max = 0;
+	uint64_t gap_sum = 0;
+
+	printf("%12s %10s  %-12s %5s %6s\n", "time (us)", "delta", "event", "arg8", "arg16");
+
+	for (uint32_t i = first; i != header.head; i++)
+	{
+		Trace_Record_t *record = &ring[i & (header.length - 1)];
+		uint32_t time = record->timestamp - ring[first & (header.length - 1)].timestamp;
+		uint32_t delta = (i == first) ? 0 : (record->timestamp - previous);
+		const char *name = (record->event < TRACE_EVENT_COUNT) ? EventNames[record->event] : "?";
+
+		printf("%12u %10u%c %-12s %5u %6u\n", (unsigned)time, (unsigned)delta,
+			   (threshold && (delta > threshold)) ? '*' : ' ', name, record->arg8, record->arg16);
+
+		previous = record->timestamp;
+
+		// Line turned around; time until the first byte comes in.
+		if ((record->event == TRACE_EVENT_DIRECTION_SWITCH) && (record->arg8 == DIRECTION_RX))
+		{
+			rx_switch = record->timestamp;
+			rx_pending = TRUE;
+		}
+		else if ((record->event == TRACE_EVENT_RX_DATA) && rx_pending)
+		{
+			uint32_t gap = record->timestamp - rx_switch;
+
+			gap_max = (gap > gap_max) ? gap : gap_max;
+			gap_sum += gap;
+			gap_count++;
+			rx_pending = FALSE;
+		}
+	}
+
+	printf("%u records", (unsigned)count);
+	if (gap_count)
+	{
+		printf("; switch to rx until first byte: %u times, avg %u us, max %u us", (unsigned)gap_count,
+			   (unsigned)(gap_sum / gap_count), (unsigned)gap_max);
+	}
+	printf("\n");
+
+	free(ring);
+
+	return EXIT_SUCCESS;
+}